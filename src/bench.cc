@@ -0,0 +1,660 @@
+/*
+ *    bench.cc
+ *
+ *    Micro benchmarks for the front end of the compiler
+ *    Build with "make bench" -- the benchmarks are compiled with optimizations on
+ *
+ *    usage: bench lexer|lexer-parallel|preprocess|conditional|parser|parser-parallel|reparse|traverse|astcache|expr [file]
+ *
+ *    Without a file, a synthetic source of a few MB is generated
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+#include "arena.hh"
+#include "astcache.hh"
+#include "errorhandler.hh"
+#include "lexer.hh"
+#include "parsecache.hh"
+#include "parser.hh"
+#include "preprocessor.hh"
+#include "sourcebuffer.hh"
+#include "threadpool.hh"
+#include "token.hh"
+
+#define BENCH_RUNS 5
+
+// Generate a source file of roughly 'size' bytes out of a sample function
+std::string
+generate_source(size_t size) {
+    std::string rv;
+    for (size_t i = 0; rv.size() < size; i++) {
+        char buf[600];
+        snprintf(buf, sizeof(buf),
+            "define int function_%zu(int x, float y) {\n"
+            "    let int total_%zu = x * 2 + 17 - x / 3;\n"
+            "    let float scale = y * 1.5 + 0.25;\n"
+            "    while (total_%zu <= 1000) {\n"
+            "        total_%zu += x % 7;\n"
+            "        if (total_%zu != 3) { total_%zu -= 1; } else { total_%zu *= 2; }\n"
+            "    }\n"
+            "    return total_%zu;\n"
+            "}\n\n",
+            i, i, i, i, i, i, i, i);
+        rv += buf;
+    }
+
+    return rv;
+}
+
+// Generate a source of roughly 'size' bytes that is about half comments
+std::string
+generate_commented_source(size_t size) {
+    std::string rv;
+    for (size_t i = 0; rv.size() < size; i++) {
+        char buf[600];
+        snprintf(buf, sizeof(buf),
+            "/*\n"
+            " * function_%zu -- adds up the first x numbers\n"
+            " * and scales them by y\n"
+            " */\n"
+            "define int function_%zu(int x, float y) {\n"
+            "    let int total = 0; // running total\n"
+            "    while (x > 0) { // count down\n"
+            "        total += x / 2;\n"
+            "        x -= 1;\n"
+            "    }\n"
+            "    return total;\n"
+            "}\n\n",
+            i, i);
+        rv += buf;
+    }
+
+    return rv;
+}
+
+// Generate a source of roughly 'size' bytes of code, where every function is followed
+// by a large section of tracing code between "$if TRACE" and "$end"
+// Without the tracing sections the code is the same, just shorter.
+std::string
+generate_instrumented_source(size_t size, bool with_tracing) {
+    std::string rv;
+    std::string function;
+    for (size_t i = 0; rv.size() < size; i++) {
+        char buf[600];
+        snprintf(buf, sizeof(buf),
+            "define int function_%zu(int x) {\n"
+            "    let int total = x * 2 + 17;\n"
+            "    return total;\n"
+            "}\n\n",
+            i);
+        rv += buf;
+        if (!with_tracing)
+            continue;
+
+        rv += "$if TRACE\n";
+        for (int j = 0; j < 8; j++) {
+            snprintf(buf, sizeof(buf),
+                "define int trace_%zu_%d(int x) {\n"
+                "    let int seen = x + %d; let float when = 0.5 * x;\n"
+                "    return seen;\n"
+                "}\n",
+                i, j, j);
+            rv += buf;
+        }
+        rv += "$end\n";
+    }
+
+    return rv;
+}
+
+// Generate a function returning one expression with 'operators' binary operators in it
+// The operators cycle through every precedence level, so the chain keeps climbing up and
+// falling back down the levels
+std::string
+generate_operator_chain(size_t operators) {
+    static const char *ops[] = {"+", "*", "-", "/", "<", "%", "==", "+", "!=", "*"};
+    std::string rv = "entry int main(int x) {\n    return x";
+    for (size_t i = 0; i < operators; i++) {
+        rv += ' ';
+        rv += ops[i % (sizeof(ops) / sizeof(ops[0]))];
+        rv += (i % 3 == 0) ? " x" : " 7";
+    }
+    rv += ";\n}\n";
+    return rv;
+}
+
+// Lex a source with a preprocessor and time it, best of BENCH_RUNS runs
+double
+time_preprocessed_lexer(std::string_view text, SourceBuffer *source, size_t *token_count) {
+    double best = 1e30;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        ErrorHandler error_handler;
+        Preprocessor preprocessor(source);
+        Lexer lexer(text);
+        lexer.error_handler = &error_handler;
+        lexer.preprocessor = &preprocessor;
+
+        auto start = std::chrono::steady_clock::now();
+        size_t count = 0;
+        for (token_t tok = lexer.next_token(); tok.type != TOK_EOF; tok = lexer.next_token())
+            count++;
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best)
+            best = seconds;
+        *token_count = count;
+    }
+
+    return best;
+}
+
+// Time lexing a source whose tracing sections are turned off, next to the same
+// source without them
+void
+bench_conditional(size_t size) {
+    SourceBuffer traced(generate_instrumented_source(size, true), "<generated>");
+    size_t live_size = 0;
+    for (size_t n = 0; n < traced.text().length(); n++) {
+        if (traced.text().compare(n, 10, "$if TRACE\n") == 0) {
+            n = traced.text().find("$end\n", n) + 4;
+            continue;
+        }
+        live_size++;
+    }
+    SourceBuffer plain(generate_instrumented_source(live_size, false), "<generated>");
+
+    size_t traced_tokens, plain_tokens;
+    double traced_time = time_preprocessed_lexer(traced.text(), &traced, &traced_tokens);
+    double plain_time = time_preprocessed_lexer(plain.text(), &plain, &plain_tokens);
+
+    printf("conditional: %zu bytes, %zu in disabled sections, %zu tokens\n",
+        traced.text().length(), traced.text().length() - live_size, traced_tokens);
+    printf("conditional: %.3f ms with tracing off, %.3f ms without the sections (%zu tokens)\n",
+        traced_time * 1e3, plain_time * 1e3, plain_tokens);
+}
+
+// Time tokenizing the whole source, best of BENCH_RUNS runs
+void
+bench_lexer(SourceBuffer *source) {
+    std::string_view text = source->text();
+    double best = 1e30;
+    size_t token_count = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        ErrorHandler error_handler;
+        Lexer lexer(text);
+        lexer.error_handler = &error_handler;
+
+        auto start = std::chrono::steady_clock::now();
+        size_t count = 0;
+        for (token_t tok = lexer.next_token(); tok.type != TOK_EOF; tok = lexer.next_token())
+            count++;
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best)
+            best = seconds;
+        token_count = count;
+    }
+
+    printf("lexer: %zu bytes, %zu tokens\n", text.length(), token_count);
+    printf("lexer: %.3f ms  %.1f Mtokens/s  %.1f MB/s\n",
+        best * 1e3,
+        token_count / best / 1e6,
+        text.length() / best / 1e6);
+}
+
+// Time filling a token buffer sequentially and on a thread pool, best of BENCH_RUNS runs each
+void
+bench_lexer_parallel(SourceBuffer *source) {
+    std::string_view text = source->text();
+    ThreadPool pool;
+    double best_sequential = 1e30;
+    double best_parallel = 1e30;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        for (int parallel = 0; parallel < 2; parallel++) {
+            ErrorHandler error_handler;
+            Lexer lexer(text);
+            lexer.error_handler = &error_handler;
+
+            auto start = std::chrono::steady_clock::now();
+            if (parallel)
+                lexer.tokenize_input_parallel(pool);
+            else
+                lexer.tokenize_input();
+            auto stop = std::chrono::steady_clock::now();
+
+            double seconds = std::chrono::duration<double>(stop - start).count();
+            double &best = parallel ? best_parallel : best_sequential;
+            if (seconds < best)
+                best = seconds;
+        }
+    }
+
+    printf("lexer-parallel: %zu bytes, %zu threads\n", text.length(), pool.size());
+    printf("lexer-parallel: sequential %.3f ms  parallel %.3f ms  %.2fx\n",
+        best_sequential * 1e3, best_parallel * 1e3, best_sequential / best_parallel);
+}
+
+// Time building the preprocessed output, next to a plain copy of the source, best of BENCH_RUNS runs each
+void
+bench_preprocess(SourceBuffer *source) {
+    std::string_view text = source->text();
+    Preprocessor preprocessor(source);
+    double best = 1e30;
+    double best_copy = 1e30;
+    size_t output_length = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        output_length = preprocessor.process().length();
+        auto stop = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best)
+            best = seconds;
+
+        std::string copy;
+        start = std::chrono::steady_clock::now();
+        copy.reserve(text.length());
+        copy.append(text.data(), text.length());
+        stop = std::chrono::steady_clock::now();
+        seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best_copy)
+            best_copy = seconds;
+    }
+
+    printf("preprocess: %zu bytes in, %zu bytes out, %zu spans\n", text.length(), output_length, preprocessor.offset_map.size());
+    printf("preprocess: %.3f ms  %.1f MB/s  (copy: %.1f MB/s)\n",
+        best * 1e3, text.length() / best / 1e6, text.length() / best_copy / 1e6);
+}
+
+// Time parsing an already lexed source into an AST and freeing it, best of BENCH_RUNS runs
+// Whatever the parser prints -- only error messages in release builds -- goes to /dev/null
+void
+bench_parser(SourceBuffer *source) {
+    std::string_view text = source->text();
+    ErrorHandler lex_errors;
+    Lexer lexer(text);
+    lexer.error_handler = &lex_errors;
+    lexer.tokenize_input();
+
+    double best_parse = 1e30, best_free = 1e30;
+    size_t arena_bytes = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        fflush(stdout);
+        int saved_stdout = dup(STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        close(devnull);
+
+        Arena *arena = new Arena();
+        ErrorHandler error_handler(text);
+        SymbolTable symbol_table(arena);
+        Parser parser(lexer.tokens);
+        parser.error_handler = &error_handler;
+        parser.symbol_table = &symbol_table;
+        parser.arena = arena;
+
+        auto start = std::chrono::steady_clock::now();
+        parser._create_ast();
+        auto parsed = std::chrono::steady_clock::now();
+        arena_bytes = arena->used;
+        delete arena;
+        auto freed = std::chrono::steady_clock::now();
+
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+
+        double parse_seconds = std::chrono::duration<double>(parsed - start).count();
+        double free_seconds = std::chrono::duration<double>(freed - parsed).count();
+        if (parse_seconds < best_parse)
+            best_parse = parse_seconds;
+        if (free_seconds < best_free)
+            best_free = free_seconds;
+    }
+
+    printf("parser: %zu bytes, %zu tokens, %zu bytes of AST\n", text.length(), lexer.tokens.size(), arena_bytes);
+    printf("parser: %.3f ms to parse  %.1f Mtokens/s, %.3f ms to free\n",
+        best_parse * 1e3, lexer.tokens.size() / best_parse / 1e6, best_free * 1e3);
+}
+
+// Time parsing an already lexed source in order and with its functions on a thread pool,
+// best of BENCH_RUNS runs each
+void
+bench_parser_parallel(SourceBuffer *source) {
+    std::string_view text = source->text();
+    ErrorHandler lex_errors;
+    Lexer lexer(text);
+    lexer.error_handler = &lex_errors;
+    lexer.tokenize_input();
+
+    ThreadPool pool;
+    double best_sequential = 1e30;
+    double best_parallel = 1e30;
+    size_t statements[2] = {0, 0};
+    size_t pooled = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        for (int parallel = 0; parallel < 2; parallel++) {
+            fflush(stdout);
+            int saved_stdout = dup(STDOUT_FILENO);
+            int devnull = open("/dev/null", O_WRONLY);
+            dup2(devnull, STDOUT_FILENO);
+            close(devnull);
+
+            Arena arena;
+            ErrorHandler error_handler(text);
+            SymbolTable symbol_table(&arena);
+            Parser parser(lexer.tokens);
+            parser.error_handler = &error_handler;
+            parser.symbol_table = &symbol_table;
+            parser.arena = &arena;
+            if (parallel)
+                parser.pool = &pool;
+
+            auto start = std::chrono::steady_clock::now();
+            AST *ast = parser._create_ast();
+            auto stop = std::chrono::steady_clock::now();
+
+            fflush(stdout);
+            dup2(saved_stdout, STDOUT_FILENO);
+            close(saved_stdout);
+
+            statements[parallel] = ast->program_node->statements.size();
+            if (parallel)
+                pooled = parser.parsed_functions.size();
+
+            double seconds = std::chrono::duration<double>(stop - start).count();
+            double &best = parallel ? best_parallel : best_sequential;
+            if (seconds < best)
+                best = seconds;
+        }
+    }
+
+    printf("parser-parallel: %zu tokens, %zu threads, %zu of %zu statements parsed on the pool\n",
+        lexer.tokens.size(), pool.size(), pooled, statements[1]);
+    if (statements[0] != statements[1])
+        printf("parser-parallel: MISMATCH -- %zu statements in order\n", statements[0]);
+    printf("parser-parallel: sequential %.3f ms  parallel %.3f ms  %.2fx\n",
+        best_sequential * 1e3, best_parallel * 1e3, best_sequential / best_parallel);
+}
+
+// Parse and check a source, with a parse cache when one is given
+// Returns the seconds spent parsing and checking -- the source is lexed before the clock starts.
+// With a cache the arena and source go to the cache, otherwise they are freed.
+double
+time_compile(SourceBuffer *source, ParseCache *cache, size_t *statements) {
+    std::string_view text = source->text();
+    ErrorHandler error_handler(text);
+    Lexer lexer(text);
+    lexer.error_handler = &error_handler;
+    lexer.tokenize_input();
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    Arena *arena = new Arena();
+    SymbolTable symbol_table(arena);
+    Parser parser(lexer.tokens);
+    parser.error_handler = &error_handler;
+    parser.symbol_table = &symbol_table;
+    parser.arena = arena;
+    parser.cache = cache;
+
+    auto start = std::chrono::steady_clock::now();
+    AST *ast = parser._create_ast();
+    ast->_syntax_analysis();
+    auto stop = std::chrono::steady_clock::now();
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    *statements = ast->program_node->statements.size();
+    if (cache != nullptr) {
+        cache->keep(arena, source);
+    } else {
+        delete arena;
+        delete source;
+    }
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+// Time compiling a source again after one of its functions was edited, from scratch and
+// with the parse cache of the compile before the edit, best of BENCH_RUNS runs each
+void
+bench_reparse(size_t size) {
+    std::string text = generate_source(size);
+
+    // edit a literal in the function in the middle of the file
+    std::string edited = text;
+    size_t middle = edited.find("* 2 + 17", edited.length() / 2);
+    edited.replace(middle, 8, "* 2 + 19");
+
+    double best_full = 1e30, best_incremental = 1e30;
+    size_t statements[2] = {0, 0};
+    size_t reused = 0, parsed = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double seconds = time_compile(new SourceBuffer(edited, "<edited>"), nullptr, &statements[0]);
+        if (seconds < best_full)
+            best_full = seconds;
+
+        ParseCache cache;
+        time_compile(new SourceBuffer(text, "<generated>"), &cache, &statements[1]);
+        seconds = time_compile(new SourceBuffer(edited, "<edited>"), &cache, &statements[1]);
+        if (seconds < best_incremental)
+            best_incremental = seconds;
+        reused = cache.reused;
+        parsed = cache.parsed;
+    }
+
+    printf("reparse: %zu bytes, %zu functions reused, %zu parsed again\n", edited.length(), reused, parsed);
+    if (statements[0] != statements[1])
+        printf("reparse: MISMATCH -- %zu statements from scratch, %zu reparsed\n", statements[0], statements[1]);
+    printf("reparse: from scratch %.3f ms  incremental %.3f ms  %.1fx  (parse + syntax analysis)\n",
+        best_full * 1e3, best_incremental * 1e3, best_full / best_incremental);
+}
+
+// Time the passes over an already parsed AST, best of BENCH_RUNS runs each
+// Setting the parents and the syntax analysis walk every node of the tree, so they are
+// mostly dispatch on the class of each node
+void
+bench_traverse(SourceBuffer *source) {
+    std::string_view text = source->text();
+    ErrorHandler error_handler(text);
+    Lexer lexer(text);
+    lexer.error_handler = &error_handler;
+    lexer.tokenize_input();
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    Arena arena;
+    SymbolTable symbol_table(&arena);
+    Parser parser(lexer.tokens);
+    parser.error_handler = &error_handler;
+    parser.symbol_table = &symbol_table;
+    parser.arena = &arena;
+    AST *ast = parser._create_ast();
+
+    double best_parents = 1e30, best_analysis = 1e30;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        ast->program_node->assign_parents();
+        auto parented = std::chrono::steady_clock::now();
+        ast->_syntax_analysis();
+        auto analysed = std::chrono::steady_clock::now();
+
+        double parent_seconds = std::chrono::duration<double>(parented - start).count();
+        double analysis_seconds = std::chrono::duration<double>(analysed - parented).count();
+        if (parent_seconds < best_parents)
+            best_parents = parent_seconds;
+        if (analysis_seconds < best_analysis)
+            best_analysis = analysis_seconds;
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    printf("traverse: %zu tokens, %zu bytes of AST\n", lexer.tokens.size(), arena.used);
+    printf("traverse: %.3f ms to set parents  %.3f ms of syntax analysis\n",
+        best_parents * 1e3, best_analysis * 1e3);
+}
+
+// Time lexing and parsing a source against loading the image of its AST, best of
+// BENCH_RUNS runs each
+void
+bench_ast_cache(SourceBuffer *source) {
+    const char *path = "/tmp/thunder_bench.ast";
+    std::string_view text = source->text();
+    double best_parse = 1e30, best_load = 1e30;
+    size_t statements[2] = {0, 0};
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, STDOUT_FILENO);
+    close(devnull);
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        Arena arena;
+        ErrorHandler error_handler(text);
+        SymbolTable symbol_table(&arena);
+
+        auto start = std::chrono::steady_clock::now();
+        Lexer lexer(text);
+        lexer.error_handler = &error_handler;
+        Parser parser(&lexer);
+        parser.error_handler = &error_handler;
+        parser.symbol_table = &symbol_table;
+        parser.arena = &arena;
+        AST *ast = parser._create_ast();
+        auto stop = std::chrono::steady_clock::now();
+
+        statements[0] = ast->program_node->statements.size();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best_parse)
+            best_parse = seconds;
+        if (run == 0 && !AstImage::save(path, ast, text)) {
+            dup2(saved_stdout, STDOUT_FILENO);
+            close(saved_stdout);
+            printf("astcache: could not write %s\n", path);
+            return;
+        }
+    }
+
+    size_t image_bytes = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        AstImage image;
+        auto start = std::chrono::steady_clock::now();
+        bool loaded = image.load(path, text);
+        auto stop = std::chrono::steady_clock::now();
+        if (!loaded)
+            break;
+
+        image_bytes = image.size;
+        statements[1] = image.ast->program_node->statements.size();
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (seconds < best_load)
+            best_load = seconds;
+    }
+    remove(path);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    printf("astcache: %zu bytes of source, %zu bytes of image\n", text.length(), image_bytes);
+    if (statements[0] != statements[1])
+        printf("astcache: MISMATCH -- %zu statements parsed, %zu loaded\n", statements[0], statements[1]);
+    printf("astcache: lex + parse %.3f ms  load %.3f ms  %.1fx\n",
+        best_parse * 1e3, best_load * 1e3, best_parse / best_load);
+}
+
+int
+main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("usage: %s lexer|lexer-parallel|preprocess|conditional|parser|parser-parallel|reparse|traverse|astcache|expr [file]\n", argv[0]);
+        return 1;
+    }
+
+    SourceBuffer *source;
+    if (argc >= 3) {
+        source = new SourceBuffer();
+        if (source->load_file(argv[2]) == false) {
+            delete source;
+            return 1;
+        }
+    } else {
+        source = new SourceBuffer(generate_source(8 << 20), "<generated>");
+    }
+
+    if (strcmp(argv[1], "lexer") == 0) {
+        bench_lexer(source);
+    } else if (strcmp(argv[1], "lexer-parallel") == 0) {
+        bench_lexer_parallel(source);
+    } else if (strcmp(argv[1], "preprocess") == 0) {
+        if (argc < 3) {
+            delete source;
+            source = new SourceBuffer(generate_commented_source(8 << 20), "<generated>");
+        }
+        bench_preprocess(source);
+    } else if (strcmp(argv[1], "conditional") == 0) {
+        bench_conditional(8 << 20);
+    } else if (strcmp(argv[1], "parser") == 0) {
+        if (argc < 3) {
+            delete source;
+            source = new SourceBuffer(generate_source(1 << 20), "<generated>");
+        }
+        bench_parser(source);
+    } else if (strcmp(argv[1], "parser-parallel") == 0) {
+        if (argc < 3) {
+            delete source;
+            source = new SourceBuffer(generate_source(1 << 20), "<generated>");
+        }
+        bench_parser_parallel(source);
+    } else if (strcmp(argv[1], "reparse") == 0) {
+        bench_reparse(1 << 20);
+    } else if (strcmp(argv[1], "traverse") == 0) {
+        if (argc < 3) {
+            delete source;
+            source = new SourceBuffer(generate_source(1 << 20), "<generated>");
+        }
+        bench_traverse(source);
+    } else if (strcmp(argv[1], "astcache") == 0) {
+        if (argc < 3) {
+            delete source;
+            source = new SourceBuffer(generate_source(1 << 20), "<generated>");
+        }
+        bench_ast_cache(source);
+    } else if (strcmp(argv[1], "expr") == 0) {
+        if (argc < 3) {
+            delete source;
+            source = new SourceBuffer(generate_operator_chain(100000), "<generated>");
+        }
+        bench_parser(source);
+    } else {
+        printf("unknown benchmark '%s'\n", argv[1]);
+        delete source;
+        return 1;
+    }
+
+    delete source;
+    return 0;
+}
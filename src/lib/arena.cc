@@ -0,0 +1,63 @@
+#include "arena.hh"
+
+#include <cstdlib>
+
+// Constructor -- the first block is only allocated when something is made
+Arena::Arena() {
+    this->current = nullptr;
+    this->limit = nullptr;
+    this->used = 0;
+}
+
+// Destructor -- free every block
+Arena::~Arena() {
+    this->reset();
+}
+
+// Free every block
+void
+Arena::reset() {
+    for (char *block : this->blocks)
+        free(block);
+    this->blocks.clear();
+    this->current = nullptr;
+    this->limit = nullptr;
+    this->used = 0;
+}
+
+// Take over the blocks of another arena
+// Whatever was made in it now lives as long as this arena. The other arena is left
+// empty and can be used again. Nothing is copied, so pointers into it stay valid.
+void
+Arena::adopt(Arena &other) {
+    this->blocks.insert(this->blocks.end(), other.blocks.begin(), other.blocks.end());
+    this->used += other.used;
+
+    other.blocks.clear();
+    other.current = nullptr;
+    other.limit = nullptr;
+    other.used = 0;
+}
+
+// Start a new block when the current one is full
+// An object bigger than a block gets a block of its own, and the current block is kept,
+// since it could still have room for the smaller objects after it
+void *
+Arena::allocate_slow(size_t size, size_t align) {
+    if (size + align > ARENA_BLOCK_SIZE / 4) {
+        char *block = (char*)malloc(size + align);
+        if (block == nullptr)
+            throw std::bad_alloc();
+        this->blocks.push_back(block);
+        this->used += size;
+        return (void*)(((uintptr_t)block + (align - 1)) & ~(uintptr_t)(align - 1));
+    }
+
+    char *block = (char*)malloc(ARENA_BLOCK_SIZE);
+    if (block == nullptr)
+        throw std::bad_alloc();
+    this->blocks.push_back(block);
+    this->current = block;
+    this->limit = block + ARENA_BLOCK_SIZE;
+    return this->allocate(size, align);
+}
@@ -0,0 +1,92 @@
+/*
+ *    arena.hh
+ *
+ *    This file contains the bump allocator that owns the AST and
+ *    the symbol tables of a compilation
+ *
+ */
+
+#pragma once
+#ifndef ARENA_
+#define ARENA_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Size of the blocks the arena carves objects out of
+// Larger objects get a block of their own
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// A list of objects living in an arena
+// It is filled once when it is made and never grows, so it is only a pointer and a count
+template <class T>
+struct ArenaList {
+    T *items = nullptr;
+    size_t count = 0;
+
+    size_t size() const { return this->count; }
+    bool empty() const { return this->count == 0; }
+    T &operator[](size_t i) const { return this->items[i]; }
+    T *begin() const { return this->items; }
+    T *end() const { return this->items + this->count; }
+};
+
+// Arena
+// Memory is handed out by bumping a pointer through large blocks, so making an object
+// costs a few instructions and no lock. Nothing made in the arena is freed on its own --
+// all of it goes at once when the arena does, at the cost of one free() per block no
+// matter how many objects were made.
+// Destructors are never run. Whatever is made in an arena must not own memory outside of
+// it: no std::vector, std::string or smart pointer members.
+class Arena {
+    public:
+        char *current;                  // next free byte in the current block
+        char *limit;                    // end of the current block
+        std::vector <char*> blocks;     // every block allocated so far
+        size_t used;                    // bytes handed out
+
+        Arena();
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // Get size bytes aligned to align -- a power of 2
+        void *allocate(size_t size, size_t align) {
+            uintptr_t p = ((uintptr_t)this->current + (align - 1)) & ~(uintptr_t)(align - 1);
+            if (p + size > (uintptr_t)this->limit)
+                return this->allocate_slow(size, align);
+            this->current = (char*)(p + size);
+            this->used += size;
+            return (void*)p;
+        }
+
+        // Make an object in the arena
+        template <class T, class... Args>
+        T *make(Args&&... args) {
+            return new (this->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        // Copy a list built up on the heap into the arena
+        template <class T>
+        ArenaList<T> list(const std::vector <T> &items) {
+            ArenaList<T> rv;
+            if (items.empty())
+                return rv;
+            rv.items = (T*)this->allocate(sizeof(T) * items.size(), alignof(T));
+            rv.count = items.size();
+            for (size_t i = 0; i < items.size(); i++)
+                new (&rv.items[i]) T(items[i]);
+            return rv;
+        }
+
+        void reset();               // free everything made in the arena
+        void adopt(Arena &other);   // take over everything made in another arena, leaving it empty
+
+    private:
+        void *allocate_slow(size_t size, size_t align);
+};
+
+#endif /* ARENA_ */
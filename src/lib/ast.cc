@@ -1,11 +1,24 @@
 #include "ast.hh"
 #include "symboltable.hh"
 #include "token.hh"
+#include "trace.hh"
 
+#include <cstdarg>
 #include <locale>
 #include <string>
 #include <cstdio>
-#include <memory>
+
+size_t sema_error_count = 0;
+
+// Print an error found by the semantic analysis and count it
+void
+sema_error(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    sema_error_count++;
+}
 
 /// UTILITY FUNCTIONS /// -- will move to utils file later
 std::string
@@ -26,25 +39,6 @@ get_data_type(DataType dt) {
     }
 }
 
-/// AST NODE BASE CLASS ///
-void
-Node::_syntax_analysis() {}
-
-void
-Node::_set_parent(Node* p) {}
-
-/// STATEMENT BASE CLASS ///
-void
-Statement::_print() {}
-void
-Statement::_syntax_analysis() {}
-
-/// EXPRESSION BASE CLASS ///
-void
-Expression::_print() {}
-void
-Expression::_syntax_analysis() {}
-
 /// PROGRAM NODE ///
 void
 Program::_print() {
@@ -60,7 +54,11 @@ void
 Program::assign_parents() {
     this->parent = nullptr;
     for (size_t i = 0; i < this->statements.size(); i++) {
-        if (this->statements[i]) this->statements[i]->_set_parent(this);
+        FunctionDecl *function = dyn_cast<FunctionDecl>(this->statements[i]);
+        if (function && function->reused)
+            function->_reparent(this);
+        else if (this->statements[i])
+            this->statements[i]->_set_parent(this);
     }
 }
 
@@ -69,21 +67,22 @@ Program::assign_parents() {
 void
 Program::_syntax_analysis() {
     for (unsigned i = 0; i < this->statements.size(); i++) {
+        // a reused function that had no errors still has none if the globals are the same
+        FunctionDecl *function = dyn_cast<FunctionDecl>(this->statements[i]);
+        if (function && function->reused && function->checked && !this->globals_changed)
+            continue;
         if (this->statements[i]) this->statements[i]->_syntax_analysis();
     }
 
     if (this->entry_point == nullptr) {
-        printf("Error: no entry point defined\n");
+        sema_error("Error: no entry point defined\n");
     }
 }
 
 // Search for the identifier in the program's symbol table
-std::shared_ptr<SymbolTableEntry>
-Program::_scope_lookup(std::string name) {
-    if (this->symbol_table->find(name) == false)
-        return nullptr;
-
-    return this->symbol_table->elements[name];
+SymbolTableEntry*
+Program::_scope_lookup(symbol_t name) {
+    return this->symbol_table.lookup(name);
 }
 
 // Set the entry point of the program to the desired function
@@ -93,7 +92,7 @@ Program::_scope_lookup(std::string name) {
 void
 Program::_set_entry(FunctionDecl* entry_point) {
     if (this->entry_point != nullptr) {
-        printf("Error: multiple entry points defined: |%s|\n", entry_point->prototype->name.c_str());
+        sema_error("Error: multiple entry points defined: |%s|\n", symbol_name(entry_point->prototype->name).c_str());
         return;
     }
 
@@ -105,55 +104,57 @@ Program::_set_entry(FunctionDecl* entry_point) {
 /// RETURN STATEMENT ///
 void
 ReturnStmt::_print() {
-    printf("%s ", this->token.literal.c_str());
-    this->ret_val->_print();
+    printf(SV_FMT " ", SV_ARG(this->token.literal));
+    if (this->ret_val != EXPR_NONE)
+        this->exprs->_print(this->ret_val);
 }
 
 // Set the parent of the return statement to the parameter
-// Set the parent of the return statement's return value to the parameter as well
 // Set the parent function that the return statement corresponds to
 void
 ReturnStmt::_set_parent(Node* p) {
     this->parent = p;
-    if(this->ret_val)
-        this->ret_val->_set_parent(p);
-
 
     // Go up the parent chain until
     // Find the function that this belongs to
     Node* cur = p;
     while (
-        dynamic_cast<Statement*>(cur)->parent != nullptr
+        cast<Statement>(cur)->parent != nullptr
     ) {
-        if (dynamic_cast<FunctionDecl*>(cur)) {
-            printf("func got\n");
+        if (isa<FunctionDecl>(cur)) {
+            TRACE(TRACE_SEMA, "func got\n");
             break;
         }
             
-        cur = dynamic_cast<Statement*>(cur)->parent;
+        cur = cast<Statement>(cur)->parent;
     }
-    this->parent_func = dynamic_cast<FunctionDecl*>(cur);
+    this->parent_func = dyn_cast<FunctionDecl>(cur);
 }
 
 // Check that the data type of this return statement's expression
 // is the same as the function that it returns to
 void
 ReturnStmt::_syntax_analysis() {
-    printf("return syn\n");
+    TRACE(TRACE_SEMA, "return syn\n");
 
-    if (this->ret_val) {
-        this->ret_val->_syntax_analysis();
+    if (this->parent_func == nullptr) {
+        sema_error("Error: return statement outside of a function\n");
+        return;
+    }
+
+    if (this->ret_val != EXPR_NONE) {
+        DataType ret_type = this->exprs->_syntax_analysis(this->ret_val, this->parent);
 
         if (
-                this->ret_val->_get_type()
+                ret_type
                 != this->parent_func->prototype->ret_type
              ) {
-            printf("Error: return type '%s' does not match declared return type '%s'\n",
-                    get_data_type(this->ret_val->_get_type()).c_str(),
+            sema_error("Error: return type '%s' does not match declared return type '%s'\n",
+                    get_data_type(ret_type).c_str(),
                     get_data_type(this->parent_func->prototype->ret_type).c_str());
         } else
-            printf("Return Match: '%s' == '%s'\n",
-                    get_data_type(this->ret_val->_get_type()).c_str(),
+            TRACE(TRACE_SEMA, "Return Match: '%s' == '%s'\n",
+                    get_data_type(ret_type).c_str(),
                     get_data_type(this->parent_func->prototype->ret_type).c_str());
     }
 }
@@ -162,10 +163,10 @@ ReturnStmt::_syntax_analysis() {
 /// EXPRESSION STATEMENT ///
 void
 ExpressionStatement::_print() {
-    if (!this->expr) {
+    if (this->expr == EXPR_NONE) {
         printf("null expr\n");
     } else {
-        this->expr->_print();
+        this->exprs->_print(this->expr);
     }
 }
 
@@ -173,17 +174,15 @@ ExpressionStatement::_print() {
 // This parameter should be a CodeBlock
 void
 ExpressionStatement::_set_parent(Node* p) {
-    if(this->expr)
-        this->expr->_set_parent(p);
-    // this->parent = p;
+    this->parent = p;
 }
 
 // Perform syntax analysis on the statement's expression value
 void
 ExpressionStatement::_syntax_analysis() {
-    printf("expr statement syn\n");
-    if (this->expr)
-        this->expr->_syntax_analysis();
+    TRACE(TRACE_SEMA, "expr statement syn\n");
+    if (this->expr != EXPR_NONE)
+        this->exprs->_syntax_analysis(this->expr, this->parent);
 }
 
 
@@ -191,12 +190,12 @@ ExpressionStatement::_syntax_analysis() {
 void
 FunctionDecl::_print() {
     if (this->is_entry)
-        printf("\nentry %s %s (", get_data_type(this->prototype->ret_type).c_str(), this->prototype->name.c_str());
+        printf("\nentry %s %s (", get_data_type(this->prototype->ret_type).c_str(), symbol_name(this->prototype->name).c_str());
     else
-        printf("\ndefine %s %s (", get_data_type(this->prototype->ret_type).c_str(), this->prototype->name.c_str());
+        printf("\ndefine %s %s (", get_data_type(this->prototype->ret_type).c_str(), symbol_name(this->prototype->name).c_str());
     
     for (size_t i = 0; i < this->prototype->params.size(); i++) {
-        printf("%s %s", get_data_type(this->prototype->params[i].data_type).c_str(), this->prototype->params[i].name.c_str());
+        printf("%s %s", get_data_type(this->prototype->params[i].data_type).c_str(), symbol_name(this->prototype->params[i].name).c_str());
         if (i < this->prototype->params.size()-1)
             printf(", ");
     }
@@ -204,7 +203,7 @@ FunctionDecl::_print() {
     if (this->func_body)
         this->func_body->_print();
 
-    printf("\n} end [%s]\n", this->prototype->name.c_str());
+    printf("\n} end [%s]\n", symbol_name(this->prototype->name).c_str());
 }
 
 // Set the parent of the function [should be the program]
@@ -212,7 +211,7 @@ FunctionDecl::_print() {
 // Perform the _set_parent on the body of the function
 void
 FunctionDecl::_set_parent(Node* p) {
-    this->parent = dynamic_cast<Program*>(p);
+    this->parent = dyn_cast<Program>(p);
     if(this->func_body) {
         this->func_body->parent = this;
         this->func_body->_set_parent(p);
@@ -223,19 +222,35 @@ FunctionDecl::_set_parent(Node* p) {
     }
 }
 
+// Point a function spliced in from an earlier parse at a new program
+// The nodes inside the function already point at each other, only the links out to the
+// global scope are set again, so this does not walk the body
+void
+FunctionDecl::_reparent(Program* program) {
+    this->parent = program;
+    if (CodeBlock *body = dyn_cast<CodeBlock>(this->func_body))
+        body->parent_scope = program;
+
+    if (this->is_entry) {
+        this->parent->_set_entry(this);
+    }
+}
+
 // Perform syntax analysis on the function body
 // [FUTURE]: perform syntax check on the function prototype
 void
 FunctionDecl::_syntax_analysis() {
-    printf("func decl syn\n");
+    TRACE(TRACE_SEMA, "func decl syn\n");
+    size_t errors = sema_error_count;
     if (this->func_body)
         this->func_body->_syntax_analysis();
+    this->checked = (sema_error_count == errors);
 }
 
 // Create symbol table entry from fields in the FunctionDecl class
-std::shared_ptr<SymbolTableEntry>
-FunctionDecl::_get_st_entry() {
-    auto symbol_table_entry = std::make_shared<SymbolTableEntry>(
+SymbolTableEntry*
+FunctionDecl::_get_st_entry(Arena *arena) {
+    auto symbol_table_entry = arena->make<SymbolTableEntry>(
                                                             this->prototype->name,
                                                             this->prototype->ret_type,
                                                             64, // size -- 64 bits for both floats and ints
@@ -249,309 +264,263 @@ FunctionDecl::_get_st_entry() {
     }
 
     symbol_table_entry->num_args = this->prototype->params.size();
-    symbol_table_entry->arg_data_types = arg_data_types;
+    symbol_table_entry->arg_data_types = arena->list(arg_data_types);
     return symbol_table_entry;
 }
 
 
-/// FUNCTION CALL EXPRESSION ///
-void
-FunctionCallExpr::_print() {
-    printf("%s(", this->name.c_str());
-    for (size_t i = 0; i < this->args.size(); i++) {
-        this->args[i]->_print();
-        if (i < this->args.size()-1)
-            printf(", ");
-    }
-    printf(") ");
-}
-
-// Set the parent of this expression to the set parameter
-void
-FunctionCallExpr::_set_parent(Node* p) {
-    this->parent = p;
-    for (size_t i = 0; i < this->args.size(); i++) {
-        this->args[i]->_set_parent(p);
-    }
-}
-
-// Get the data type of the function call
-// [THIS MIGHT NEED TO BE SYMBOL TABLE LOOKUP -- TEST]
-DataType
-FunctionCallExpr::_get_type() {
-    std::shared_ptr<SymbolTableEntry> func_ident = this->parent->_scope_lookup(this->name);
-    if (func_ident == nullptr)
-        return TYPE_VOID;
-
-    return func_ident->data_type;
+/// EXPRESSIONS ///
+
+// Spelling of the operator of a binary expression or assignment
+static const char*
+operator_spelling(uint8_t op) {
+    switch (op) {
+        case TOK_EQUALS:        return "=";
+        case TOK_PLUS:          return "+";
+        case TOK_MINUS:         return "-";
+        case TOK_BANG:          return "!";
+        case TOK_ASTERISK:      return "*";
+        case TOK_SLASH:         return "/";
+        case TOK_MOD:           return "%";
+        case TOK_PLUS_EQUAL:    return "+=";
+        case TOK_MINUS_EQUAL:   return "-=";
+        case TOK_TIMES_EQUAL:   return "*=";
+        case TOK_DIV_EQUAL:     return "/=";
+        case TOK_MOD_EQUAL:     return "%=";
+        case TOK_GT:            return ">";
+        case TOK_LT:            return "<";
+        case TOK_EQUALTO:       return "==";
+        case TOK_NOTEQUALTO:    return "!=";
+        case TOK_GTEQUALTO:     return ">=";
+        case TOK_LTEQUALTO:     return "<=";
+        default:                return "?";
+    }
+}
+
+// Look a name up from a scope -- nullptr if there is no scope to look in
+static inline SymbolTableEntry*
+scope_lookup(Node *scope, symbol_t name) {
+    if (scope == nullptr)
+        return nullptr;
+    return scope->_scope_lookup(name);
 }
 
-// [FUTURE: PERFORM SYNTAX CHECK ON FUNCTION CALL]
-void
-FunctionCallExpr::_syntax_analysis() {
-    std::shared_ptr<SymbolTableEntry> ste = this->parent->_scope_lookup(this->name);
-    if (!ste) {
-        printf("FUNC CALL SYN NULL STE\n");
-        return;
-    }
-
-    // Check that there are the same amount of arguments as declared parameters
-    if (ste->num_args != this->args.size()) {
-        printf("Error: incorrect number of arguments in function call. Expected %lu got %lu\n", ste->num_args, this->args.size());
-    } else {
-        printf("ARG MATCH %lu == %lu\n", ste->num_args, this->args.size());
-    }
-
-    // Check that the argument data types match the parameter data types
-    for (size_t i = 0; i < this->args.size(); i++) {
-        if (ste->arg_data_types[i]) {
-            if (this->args[i]->_get_type() != ste->arg_data_types[i]) {
-                printf("Error: function '%s' argument %lu incorrect data type. Expected |%s| got |%s|\n",
-                        this->name.c_str(),
-                        i,
-                        get_data_type(ste->arg_data_types[i]).c_str(),
-                        get_data_type(this->args[i]->_get_type()).c_str());
-            } else {
-                printf("ARG TYPE MATCH %s == %s\n", 
-                        get_data_type(ste->arg_data_types[i]).c_str(),
-                        get_data_type(this->args[i]->_get_type()).c_str());
-            }
-        } else {
-            printf("Error: too many function arguments for |%s|. Expected %lu got %lu\n",
-                    this->name.c_str(),
-                    ste->num_args,
-                    this->args.size()
-                  );
-            break;
+// Find the first node of the run of the table that holds an expression
+// That is the first node of its first operand, and of that operand's first operand, and
+// so on down to an expression without operands
+expr_t
+ExprTable::_first(expr_t root) {
+    expr_t first = root;
+    while (1) {
+        const expr_node_t &node = this->nodes[first];
+        expr_t operand = EXPR_NONE;
+        switch (node.kind) {
+            case NODE_BINARY:
+            case NODE_ASSIGNMENT:
+                operand = (node.children[0] != EXPR_NONE) ? node.children[0] : node.children[1];
+                break;
+            case NODE_CALL:
+                if (node.children[1] > 0)
+                    operand = this->args[node.children[0]];
+                break;
+            default:
+                break;
         }
-    }
-    printf("func call syn\n");
-}
 
-
-/// INTEGER EXPRESSION ///
-void
-IntegerExpr::_print() {
-    std::string dt;
-    switch (this->data_type) {
-        case TYPE_INT:
-            dt = "int";
-            break;
-        case TYPE_FLOAT:
-            dt = "float";
-            break;
-        case TYPE_STRING:
-            dt = "string";
-            break;
-        default:
-            dt = "invalid";
-            break;
+        if (operand == EXPR_NONE)
+            return first;
+        first = operand;
     }
-
-    printf("[[ intexpr val: %lld type: %s ]]", this->value, dt.c_str());
 }
 
-// Return the data type of this expression
-// [should always be TYPE_INT]
-DataType
-IntegerExpr::_get_type() {
-    return this->data_type;
-}
-
-// Set the parent of the integer expression [should be a CodeBlock]
 void
-IntegerExpr::_set_parent(Node* p) {
-    this->parent = p;
-}
-
-// Integer expr syntax check
-void
-IntegerExpr::_syntax_analysis() {
-    printf("int expr syn\n");
-}
+ExprTable::_print(expr_t root) {
+    const expr_node_t &node = this->nodes[root];
+    switch (node.kind) {
+        case NODE_BINARY:
+            printf("[ ");
+            if (node.children[0] != EXPR_NONE)
+                this->_print(node.children[0]);
+            printf(" ]");
 
+            printf(" %s ", operator_spelling(node.op));
 
-/// FLOAT EXPRESSION ///
-void
-FloatExpr::_print() {
-    std::string dt;
-    switch (this->data_type) {
-        case TYPE_INT:
-            dt = "int";
-            break;
-        case TYPE_FLOAT:
-            dt = "float";
-            break;
-        case TYPE_STRING:
-            dt = "string";
-            break;
-        default:
-            dt = "invalid";
+            printf("[ ");
+            if (node.children[1] != EXPR_NONE)
+                this->_print(node.children[1]);
+            printf(" ]");
             break;
-    }
 
-    printf("[[ floatexpr val: %lf type: %s ]]", this->value, dt.c_str());
-}
+        case NODE_ASSIGNMENT:
+            this->_print(node.children[0]);
+            printf(" %s ", operator_spelling(node.op));
+            if (node.children[1] != EXPR_NONE)
+                this->_print(node.children[1]);
+            break;
 
-// Return the data type of the expression
-// [should always be TYPE_FLOAT]
-DataType
-FloatExpr::_get_type() {
-    return this->data_type;
-}
+        case NODE_INTEGER:
+            printf("[[ intexpr val: %lld type: %s ]]", (long long)node.int_value, get_data_type((DataType)node.data_type).c_str());
+            break;
 
-// Set the parent of the expression
-void
-FloatExpr::_set_parent(Node* p) {
-    this->parent = p;
-}
+        case NODE_BYTE:
+            printf("[[ byte val: %lld type: %s ]]", (long long)node.int_value, get_data_type((DataType)node.data_type).c_str());
+            break;
 
-// Perform syntax check on the expression
-void
-FloatExpr::_syntax_analysis() {
-    printf("float expr syn\n");
-}
+        case NODE_FLOAT:
+            printf("[[ floatexpr val: %lf type: %s ]]", node.float_value, get_data_type((DataType)node.data_type).c_str());
+            break;
 
-/// BYTE EXPRESSION ///
-void
-ByteExpr::_print() {
-    std::string dt;
-    switch (this->data_type) {
-        case TYPE_INT:
-            dt = "int";
+        case NODE_BOOLEAN:
+            printf("[[ boolean val: %s ]]", node.int_value ? "true" : "false");
             break;
-        case TYPE_BYTE:
-            dt = "byte";
+
+        case NODE_CALL:
+            printf("%s(", symbol_name(node.name).c_str());
+            for (expr_t i = 0; i < node.children[1]; i++) {
+                this->_print(this->args[node.children[0] + i]);
+                if (i < node.children[1] - 1)
+                    printf(", ");
+            }
+            printf(") ");
             break;
-        case TYPE_FLOAT:
-            dt = "float";
+
+        case NODE_IDENTIFIER:
+            printf("%s", symbol_name(node.name).c_str());
             break;
-        case TYPE_STRING:
-            dt = "string";
+
+        case NODE_VARIABLE:
+            // strings have no name printed yet
+            if (node.data_type != TYPE_STRING && node.data_type <= TYPE_VOID)
+                printf("[name: '%s' type: '%s'] ", symbol_name(node.name).c_str(), get_data_type((DataType)node.data_type).c_str());
             break;
+
+        case NODE_EMPTY:
         default:
-            dt = "invalid";
             break;
     }
-
-    printf("[[ byte val: %lld type: %s ]]", this->value, dt.c_str());
-}
-
-// Get the data type of this expression
-// [should always be TYPE_BYTE]
-DataType
-ByteExpr::_get_type() {
-    return this->data_type;
-}
-
-// Set the parent of the byte expression
-// [should always be CodeBlock]
-void
-ByteExpr::_set_parent(Node* p) {
-    this->parent = p;
-}
-
-// Perform syntax check on the expression
-void
-ByteExpr::_syntax_analysis() {
-    printf("byte expr syn\n");
 }
 
-
-/// BOOLEAN EXPRESSION ///
-void
-BooleanExpr::_print() {
-    std::string val = (this->value == true) ? "true" : "false";
-    printf("[[ boolean val: %s ]]", val.c_str());
-}
-
-// Return data type of the expression
-// [should always be TYPE_BOOL]
+// Syntax check an expression and work out the data type of every part of it
+// The operands of a node come before it in the table, so one pass over the run of the
+// expression sees every operand's type before the node using it. Each mismatch is
+// reported once, at the node where it happens -- a node whose operands do not match is
+// TYPE_VOID to the nodes using it.
+// [FUTURE]
+//        TYPE_FLOAT, TYPE_INT, and TYPE_BYTE are all valid types to
+//        be operated on together, so perform casting rather than saying
+//        it is invalid.
 DataType
-BooleanExpr::_get_type() {
-    return this->data_type;
-}
-
-// Set the parent of the expression
-// [should always be CodeBlock]
-void
-BooleanExpr::_set_parent(Node* p) {
-    this->parent = p;
-}
-
-// Perform syntax check on the expression
-void
-BooleanExpr::_syntax_analysis() {
-    printf("bool expr syn\n");
-}
-
+ExprTable::_syntax_analysis(expr_t root, Node *scope) {
+    auto type_of = [this](expr_t expr) {
+        return (expr == EXPR_NONE) ? TYPE_VOID : (DataType)this->nodes[expr].data_type;
+    };
+
+    for (expr_t i = this->_first(root); i <= root; i++) {
+        expr_node_t &node = this->nodes[i];
+        switch (node.kind) {
+            case NODE_BINARY: {
+                TRACE(TRACE_SEMA, "binary expr syn\n");
+                DataType lhs_type = type_of(node.children[0]);
+                DataType rhs_type = type_of(node.children[1]);
+                if (node.children[0] != EXPR_NONE && node.children[1] != EXPR_NONE) {
+                    if (lhs_type != rhs_type)
+                        sema_error("Error: BinaryExpr::_syntax_analysis() -- %s != %s\n", get_data_type(lhs_type).c_str(), get_data_type(rhs_type).c_str());
+                    else
+                        TRACE(TRACE_SEMA, "typematch %s == %s\n", get_data_type(lhs_type).c_str(), get_data_type(rhs_type).c_str());
+                }
+                node.data_type = (lhs_type == rhs_type) ? lhs_type : TYPE_VOID;
+                break;
+            }
 
-/// IDENTIFIER EXPRESSION ///
-void
-IdentifierExpr::_print() {
-    printf("%s", this->name.c_str());
-}
+            case NODE_ASSIGNMENT: {
+                TRACE(TRACE_SEMA, "var assign syn\n");
+                DataType variable_type = type_of(node.children[0]);
+                if (node.children[1] != EXPR_NONE && variable_type != type_of(node.children[1])) {
+                    sema_error("Error: invalid variable assignment: type incompatibility %s != %s\n", get_data_type(variable_type).c_str(), get_data_type(type_of(node.children[1])).c_str());
+                }
+                node.data_type = variable_type;
+                break;
+            }
 
-// Create a symbol table entry out of an identifier expression
-// using its fields
-// This will be used to insert into a symbol table
-std::shared_ptr<SymbolTableEntry>
-IdentifierExpr::_get_st_entry() {
-    auto ste = std::make_shared<SymbolTableEntry>(
-        this->name,
-        this->data_type,
-        64,
-        1,
-        1
-    );
+            case NODE_CALL: {
+                TRACE(TRACE_SEMA, "func call syn\n");
+                SymbolTableEntry *ste = scope_lookup(scope, node.name);
+                if (!ste) {
+                    TRACE(TRACE_SEMA, "FUNC CALL SYN NULL STE\n");
+                    node.data_type = TYPE_VOID;
+                    break;
+                }
+                node.data_type = ste->data_type;
+
+                // Check that there are the same amount of arguments as declared parameters
+                size_t arg_count = node.children[1];
+                if (ste->num_args != arg_count) {
+                    sema_error("Error: incorrect number of arguments in function call. Expected %lu got %lu\n", ste->num_args, arg_count);
+                } else {
+                    TRACE(TRACE_SEMA, "ARG MATCH %lu == %lu\n", ste->num_args, arg_count);
+                }
+
+                // Check that the argument data types match the parameter data types
+                for (size_t a = 0; a < arg_count; a++) {
+                    DataType arg_type = type_of(this->args[node.children[0] + a]);
+                    if (a >= ste->arg_data_types.size()) {
+                        sema_error("Error: too many function arguments for |%s|. Expected %lu got %lu\n",
+                                symbol_name(node.name).c_str(),
+                                ste->num_args,
+                                arg_count
+                              );
+                        break;
+                    }
+                    if (arg_type != ste->arg_data_types[a]) {
+                        sema_error("Error: function '%s' argument %lu incorrect data type. Expected |%s| got |%s|\n",
+                                symbol_name(node.name).c_str(),
+                                a,
+                                get_data_type(ste->arg_data_types[a]).c_str(),
+                                get_data_type(arg_type).c_str());
+                    } else {
+                        TRACE(TRACE_SEMA, "ARG TYPE MATCH %s == %s\n",
+                                get_data_type(ste->arg_data_types[a]).c_str(),
+                                get_data_type(arg_type).c_str());
+                    }
+                }
+                break;
+            }
 
-    return ste;
-}
+            case NODE_IDENTIFIER: {
+                TRACE(TRACE_SEMA, "ident expr syn\n");
+                // lookup identifier in symbol table to see if it is there
+                SymbolTableEntry *ident_ste = scope_lookup(scope, node.name);
+                if (!ident_ste) {
+                    sema_error("Error: identifier |%s| not found in this scope\n", symbol_name(node.name).c_str());
+                    node.data_type = TYPE_VOID;
+                } else {
+                    TRACE(TRACE_SEMA, "Found: ident |%s|\n", symbol_name(node.name).c_str());
+                    node.data_type = ident_ste->data_type;
+                }
+                break;
+            }
 
-// Return the data type of the identifier
-// This is done by doing a lookup of the identifier in its scope's 
-// symbol table and go upwards to the program scope.
-// If it is found, return the data type, if not, return TYPE_VOID
-DataType
-IdentifierExpr::_get_type() {
-    // Find the identifier in symbol table and 
-    // return its data type
+            case NODE_EMPTY:
+                node.data_type = TYPE_VOID;
+                break;
 
-    std::shared_ptr<SymbolTableEntry> ident = this->parent->_scope_lookup(this->name);
-    if (ident == nullptr) {
-        return TYPE_VOID;
+            // literals and variables keep the type the parser gave them
+            default:
+                break;
+        }
     }
-    return ident->data_type;
-}
-
-// Sets the parent of the identifier
-void
-IdentifierExpr::_set_parent(Node* p) {
-    this->parent = p;
-}
 
-// Performs syntax check on the identifier
-// This is done by doing a lookup of the identifier in its scope's
-// symbol table, and seeing if it is there or not
-void
-IdentifierExpr::_syntax_analysis() {
-    printf("ident expr syn\n");
-    // lookup identifier in symbol table to see if it is there
-    auto ident_ste = this->parent->_scope_lookup(this->name);
-    if (!ident_ste) {
-        printf("Error: identifier |%s| not found in this scope\n", this->name.c_str());
-    } else {
-        printf("Found: ident |%s|\n", this->name.c_str());
-    }
+    return type_of(root);
 }
 
 
 /// CONDITIONAL STATEMENT ///
 void
 Conditional::_print() {
-    printf("%s ", this->token.literal.c_str());
+    printf(SV_FMT " ", SV_ARG(this->token.literal));
     printf("(");
-    this->condition->_print();
+    if (this->condition != EXPR_NONE)
+        this->exprs->_print(this->condition);
     printf(") {\n");
 
     if (this->consequence)
@@ -568,7 +537,6 @@ Conditional::_print() {
 }
 
 // Set the parent of the Conditional [should be either Program or CodeBlock]
-// Set the parent of the condition     [should be either Program or CodeBlock]
 // Set the parent of the consuence to the Conditional
 // Perform the _set_parent logic down the chain on the body
 // Loop until there is not alternative clause in the chain and do the same for each
@@ -576,15 +544,13 @@ void
 Conditional::_set_parent(Node* p) {
     Conditional *cur = this;
     this->parent = p;
-    this->condition->_set_parent(p);
     this->consequence->parent = this;
     this->consequence->_set_parent(p);
 
     while (cur->alternative) {
-        printf("got alt\n");
-        cur = dynamic_cast<Conditional*>(cur->alternative.get());
+        TRACE(TRACE_SEMA, "got alt\n");
+        cur = dyn_cast<Conditional>(cur->alternative);
         cur->parent = p;
-        cur->condition->_set_parent(p);
         cur->consequence->parent = this;
         cur->consequence->_set_parent(p);
     }
@@ -595,31 +561,31 @@ Conditional::_set_parent(Node* p) {
 // other clauses in the chain
 void
 Conditional::_syntax_analysis() {
-    printf("conditional syn\n");
-    if (this->condition)
-        this->condition->_syntax_analysis();
+    TRACE(TRACE_SEMA, "conditional syn\n");
+    if (this->condition != EXPR_NONE)
+        this->exprs->_syntax_analysis(this->condition, this->parent);
     else {
-        printf("Error: no condition in if statement\n");
+        sema_error("Error: no condition in if statement\n");
     }
 
     if (this->consequence)
         this->consequence->_syntax_analysis();
     else {
-        printf("Error: missing code block from if-statement\n");
+        sema_error("Error: missing code block from if-statement\n");
     }
 
     // this->alternative->_syntax_analysis();
     Conditional* cur = this;
     while (cur->alternative) {
-        cur = dynamic_cast<Conditional*>(cur->alternative.get());
-        if (cur->condition)
-            cur->condition->_syntax_analysis();
+        cur = dyn_cast<Conditional>(cur->alternative);
+        if (cur->condition != EXPR_NONE)
+            cur->exprs->_syntax_analysis(cur->condition, cur->parent);
         else 
-            printf("Error: no condition on if-else statement\n");
+            sema_error("Error: no condition on if-else statement\n");
         if (cur->consequence)
             cur->consequence->_syntax_analysis();
         else
-            printf("Error: missing code block on if-else statement\n");
+            sema_error("Error: missing code block on if-else statement\n");
     }
 }
 
@@ -627,10 +593,10 @@ Conditional::_syntax_analysis() {
 /// WHILE LOOP STATEMENT ///
 void
 WhileLoop::_print() {
-    printf("%s ", this->token.literal.c_str());
+    printf(SV_FMT " ", SV_ARG(this->token.literal));
     printf("(");
-    if (this->condition) {
-        this->condition->_print();
+    if (this->condition != EXPR_NONE) {
+        this->exprs->_print(this->condition);
     }
     printf(") {\n");
 
@@ -642,14 +608,11 @@ WhileLoop::_print() {
 }
 
 // Set the parent of the while loop [should be CodeBlock]
-// Set the parent of the condition    [should be CodeBlock]
 // Set the parent of the loop_body to the WhileLoop itself
 // Continue _set_parent chain through the body
 void
 WhileLoop::_set_parent(Node* p) {
     this->parent = p;
-    if(this->condition)
-        this->condition->_set_parent(p);
     if(this->loop_body) {
         this->loop_body->parent = this;
         this->loop_body->_set_parent(p);
@@ -660,9 +623,9 @@ WhileLoop::_set_parent(Node* p) {
 // and body of the while loop
 void
 WhileLoop::_syntax_analysis() {
-    printf("while syn\n");
-    if (this->condition)
-        this->condition->_syntax_analysis();
+    TRACE(TRACE_SEMA, "while syn\n");
+    if (this->condition != EXPR_NONE)
+        this->exprs->_syntax_analysis(this->condition, this->parent);
 
     if (this->loop_body)
         this->loop_body->_syntax_analysis();
@@ -672,52 +635,51 @@ WhileLoop::_syntax_analysis() {
 /// FOR LOOP STATEMENT ///
 void
 ForLoop::_print() {
-    printf("%s (\n", this->token.literal.c_str());
+    printf(SV_FMT " (\n", SV_ARG(this->token.literal));
 
     printf("\t");
-    this->initialization->_print();
+    if (this->initialization)
+        this->initialization->_print();
     printf("\n\t");
-    this->condition->_print();
+    if (this->condition != EXPR_NONE)
+        this->exprs->_print(this->condition);
     printf("\n\t");
-    this->action->_print();
+    if (this->action != EXPR_NONE)
+        this->exprs->_print(this->action);
 
     printf("\n) {\n");
-    this->loop_body->_print();
+    if (this->loop_body)
+        this->loop_body->_print();
     printf("} end [for]\n");
 }
 
 // Set the parent of the ForLoop [should be CodeBlock]
 // Set the parent of the initialization [should be CodeBlock]
-// Set the parent of the condition to the body of the for loop
-// Set the parent of the action to the body of the for loop
 // Set the parent of the body to the ForLoop itself
+// The condition and action are looked up in the body of the for loop
 // Continue _set_parent chain through the body
 void
 ForLoop::_set_parent(Node* p) {
-    this->parent = dynamic_cast<CodeBlock*>(this);
+    this->parent = nullptr;
     if(this->loop_body) {
         this->loop_body->parent = this;
         this->loop_body->_set_parent(p);
     }
     if(this->initialization)
         this->initialization->_set_parent(p);
-    if(this->condition)
-        this->condition->_set_parent(dynamic_cast<CodeBlock*>(this->loop_body.get()));
-    if(this->action)
-        this->action->_set_parent(dynamic_cast<CodeBlock*>(this->loop_body.get()));
 }
 
 // Perform syntax check on the initialization,
 // condition, action, and body of the loop
 void
 ForLoop::_syntax_analysis() {
-    printf("for syn\n");
+    TRACE(TRACE_SEMA, "for syn\n");
     if (this->initialization)
         this->initialization->_syntax_analysis();
-    if(this->condition)
-        this->condition->_syntax_analysis();
-    if(this->action)
-        this->action->_syntax_analysis();
+    if(this->condition != EXPR_NONE)
+        this->exprs->_syntax_analysis(this->condition, this->loop_body);
+    if(this->action != EXPR_NONE)
+        this->exprs->_syntax_analysis(this->action, this->loop_body);
     if(this->loop_body)
         this->loop_body->_syntax_analysis();
 }
@@ -751,7 +713,7 @@ CodeBlock::_set_parent(Node* p) {
 // its body
 void
 CodeBlock::_syntax_analysis() {
-    printf("code block syn\n");
+    TRACE(TRACE_SEMA, "code block syn\n");
     for (size_t i = 0; i < this->body.size(); i++) {
         if(this->body[i])
             this->body[i]->_syntax_analysis();
@@ -761,246 +723,66 @@ CodeBlock::_syntax_analysis() {
 // Lookup the name in the symbol table of this scope 
 // if name is found, return the entry corresponding to it
 // otherwise, search the symbol table of the parent
-std::shared_ptr<SymbolTableEntry>
-CodeBlock::_scope_lookup(std::string name) {
+SymbolTableEntry*
+CodeBlock::_scope_lookup(symbol_t name) {
     CodeBlock* current_block = this;                                                                 // current block we are looking at
-    std::shared_ptr<SymbolTable> current_table = this->symbol_table; // table of the current scope we are examining
+    SymbolTable *current_table = &this->symbol_table; // table of the current scope we are examining
 
     // Loop until we either find the identifier or exhaust all scopes
     while (1) {
-        if (current_table->find(name)) {
+        if (SymbolTableEntry *entry = current_table->lookup(name)) {
             // Found the identifier
-            return current_table->elements[name];
+            return entry;
         } else {
-            if(dynamic_cast<Program*>(current_block->parent_scope)) {
-                printf("CodeBlock::_scope_lookup() -- Program Parent switch\n");
+            if(isa<Program>(current_block->parent_scope)) {
+                TRACE(TRACE_SEMA, "CodeBlock::_scope_lookup() -- Program Parent switch\n");
                 // Parent scope is the Program Scope
-                auto final_scope = dynamic_cast<Program*>(current_block->parent_scope);
+                auto final_scope = cast<Program>(current_block->parent_scope);
                 return final_scope->_scope_lookup(name);
             } else {
-                printf("CodeBlock::_scope_lookup() -- CB Parent switch\n");
+                TRACE(TRACE_SEMA, "CodeBlock::_scope_lookup() -- CB Parent switch\n");
                 // Set the current scope to its parents scope
-                current_block = dynamic_cast<CodeBlock*>(current_block->parent_scope);
-                current_table = current_block->symbol_table;
+                current_block = cast<CodeBlock>(current_block->parent_scope);
+                current_table = &current_block->symbol_table;
             }
         }
     }
 }
 
 
-/// VARIABLE EXPRESSION ///
-void
-VariableExpr::_print() {
-    std::string dt;
-    switch (this->data_type) {
-        case TYPE_INT:
-            dt = "int";
-            printf("[name: '%s' type: '%s'] ",
-                    this->name.c_str(), dt.c_str());
-            break;
-        case TYPE_BYTE:
-            dt = "byte";
-            printf("[name: '%s' type: '%s'] ",
-                    this->name.c_str(), dt.c_str());
-            break;
-        case TYPE_FLOAT:
-            dt = "float";
-            printf("[name: '%s' type: '%s'] ",
-                    this->name.c_str(), dt.c_str());
-            break;
-        case TYPE_BOOL:
-            dt = "bool";
-            printf("[name: '%s' type: '%s'] ",
-                    this->name.c_str(), dt.c_str());
-            break;
-        case TYPE_STRING:
-            dt = "string";
-            break;
-        case TYPE_VOID:
-            dt = "void";
-            printf("[name: '%s' type: '%s'] ",
-                    this->name.c_str(), dt.c_str());
-        default:
-            dt = "invalid";
-            break;
-    }
-
-}
-
-// Get the data type of the variable
-DataType
-VariableExpr::_get_type() {
-    return this->data_type;
-}
-
-// Set the parent of the variable
-void
-VariableExpr::_set_parent(Node* p) {
-    this->parent = p;
-}
-
-// [FUTURE: perform syntax check on variable]
-void
-VariableExpr::_syntax_analysis() {
-    printf("var expr syn\n");
-}
-
-
-/// VARIABLE ASSIGNMENT EXPRESSION ///
-void
-VariableAssignment::_print() {
-    this->variable->_print();
-    printf(" %s ", this->op.literal.c_str());
-    if (this->RHS)
-        this->RHS->_print();
-}
-
-// Set the parent of the variable [should be either CodeBlock or Program]
-// Set the parent of the assigned expression [should be either CodeBlock or Program]
-void
-VariableAssignment::_set_parent(Node* p) {
-    this->parent = p;
-    if(this->RHS)
-        this->RHS->_set_parent(p);
-}
-
-// Perform syntax check on the assignment
-// Check that the type of the assigned expression 
-// matches the declared data type of the variable
-void
-VariableAssignment::_syntax_analysis() {
-    printf("var assign syn\n");
-    if (this->RHS) {
-        this->RHS->_syntax_analysis();
-        if (this->variable && this->variable->_get_type() != this->RHS->_get_type()) {
-            printf("Error: invalid variable assignment: type incompatibility %s != %s\n", get_data_type(this->variable->_get_type()).c_str(), get_data_type(this->RHS->_get_type()).c_str());
-        }
-    }
-}
-
-// Return the data type of the assigned expression
-DataType
-VariableAssignment::_get_type() {
-    return this->data_type;
-}
-
-
-/// BINARY EXPRESSION ///
-void
-BinaryExpr::_print() {
-    // printf("lhs: ");
-    printf("[ ");
-    this->LHS->_print();
-    printf(" ]");
-    
-    printf(" %s ", this->op.literal.c_str());
-    
-    // printf("rhs: ");
-    printf("[ ");
-    this->RHS->_print();
-    printf(" ]");
-}
-
-// Check if the data types of the left and right hand sides 
-// are the same type. If they are, return that type. 
-// If not, return TYPE_VOID
-// [FUTURE]
-//        TYPE_FLOAT, TYPE_INT, and TYPE_BYTE are all valid types to 
-//        be operated on together, so perform casting rather than saying
-//        it is invalid.
-DataType
-BinaryExpr::_get_type() {
-    DataType rhs_type = TYPE_VOID, lhs_type = TYPE_VOID;
-
-    if (this->LHS)
-        lhs_type = this->LHS->_get_type();
-
-    if (this->RHS)
-        rhs_type = this->RHS->_get_type();
-
-    if (rhs_type == lhs_type) {
-        return rhs_type;
-    } else {
-        printf("Error: BinaryExpr::_get_type(): %s != %s\n", get_data_type(lhs_type).c_str(), get_data_type(rhs_type).c_str());
-        return TYPE_VOID;
-    }
-}
-
-// Set the parent of the expression and left/right hand sides
-// [should be CodeBlock]
-void
-BinaryExpr::_set_parent(Node* p) {
-    this->parent = p;
-    if(this->LHS)
-        this->LHS->_set_parent(p);
-    if(this->RHS)
-        this->RHS->_set_parent(p);
-}
-
-// Syntax check the binary expression
-// Perform checks on the left and right hand sides
-// Check that the types of the left and right hand sides are the same
-void
-BinaryExpr::_syntax_analysis() {
-    printf("binary expr syn\n");
-
-    // bool rhs_check = false, lhs_check = false;
-    if (this->LHS) {
-        this->LHS->_syntax_analysis();
-    }
-
-    // RIGHT HAND SIDE
-    if (this->RHS) {
-        this->RHS->_syntax_analysis();
-    } 
-
-    // Check for compatible data types
-    if (this->LHS && this->RHS) {
-        if (this->LHS->_get_type() != this->RHS->_get_type()) {
-            printf("Error: BinaryExpr::_syntax_analysis() -- %s != %s\n", get_data_type(this->LHS->_get_type()).c_str(), get_data_type(this->RHS->_get_type()).c_str());
-        } else {
-            printf("typematch %s == %s\n", get_data_type(this->LHS->_get_type()).c_str(), get_data_type(this->RHS->_get_type()).c_str());
-        }
-    }
-}
-
-
 /// LET STATEMENT ///
 void
 LetStmt::_print() {
-    printf("%s ", this->token.literal.c_str());
-    if (this->var_assign)
-        this->var_assign->_print();
+    printf(SV_FMT " ", SV_ARG(this->token.literal));
+    if (this->var_assign != EXPR_NONE)
+        this->exprs->_print(this->var_assign);
     else 
         printf("invalid variable assignment\n");
 }
 
-// Set the parent of the variable being assigned 
-// and the expression it is being assigned to
+// Set the parent of the statement, where the names in the
+// expression being assigned are looked up
 // [should be either CodeBlock or Program]
 void
 LetStmt::_set_parent(Node* p) {
-    if(this->variable)
-        this->variable->_set_parent(p);
-    if(this->var_assign)
-        this->var_assign->_set_parent(p);
+    this->parent = p;
 }
 
 
 // Perform syntax analysis on the variable declaration
 void
 LetStmt::_syntax_analysis() {
-    printf("let syn\n");
-    if(this->var_assign)
-        this->var_assign->_syntax_analysis();
+    TRACE(TRACE_SEMA, "let syn\n");
+    if(this->var_assign != EXPR_NONE)
+        this->exprs->_syntax_analysis(this->var_assign, this->parent);
 }
 
 // Creates and returns a symbol table entry from the values in the statement
-std::shared_ptr<SymbolTableEntry>
-LetStmt::_get_st_entry() {
-    auto symbol_table_entry = std::make_shared<SymbolTableEntry>(
-        dynamic_cast<VariableExpr*>(this->variable.get())->name,
-        dynamic_cast<VariableExpr*>(this->variable.get())->data_type,
+SymbolTableEntry*
+LetStmt::_get_st_entry(Arena *arena) {
+    auto symbol_table_entry = arena->make<SymbolTableEntry>(
+        this->name,
+        this->data_type,
         64, // size -- 64 bits for both floats and ints
         1,    // dimensions -- 1 because we do not parse arrays yet
         1     // decl line -- change when we read this when parsing
@@ -1015,7 +797,7 @@ LetStmt::_get_st_entry() {
 // 1: check if identifier exists in scope or up its parent scopes symbol tables
 bool
 AST::_syntax_analysis() {
-    std::shared_ptr<Program> root = this->program_node;
+    Program *root = this->program_node;
     if (root)
         root->_syntax_analysis();
 //    for (unsigned i = 0; i < root->statements.size(); i++) {
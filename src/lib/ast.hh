@@ -11,88 +11,177 @@
 #include "token.hh"
 #include "symboltable.hh"
 #include "errorhandler.hh"
+#include "arena.hh"
+#include <cassert>
+#include <cstdint>
 #include <vector>
 #include <string>
-#include <memory>
 
 
+// Number of errors the semantic analysis has printed so far
+extern size_t sema_error_count;
+void sema_error(const char *format, ...) __attribute__((format(printf, 1, 2))); // print a semantic error and count it
+
 // The Abstract Syntax Tree itself
+// Every node of the tree lives in the arena of the compilation that parsed it. Nodes point
+// at each other with plain pointers and are never freed one by one -- the arena frees the
+// whole tree at once. Nodes are never destroyed either, so they hold no std::vector,
+// std::string or smart pointer members; their lists are ArenaLists.
 class AST {
     public:
-        std::shared_ptr<class Program> program_node;
+        class Program *program_node;
         bool _syntax_analysis(); // iterates over the tree and performs syntax analysis
 };
 
+// Kind of a node in the AST
+// Every node stores its kind, so a pass switches on it (see visit) and isa/cast test it
+// with one compare instead of going through RTTI and the vtable. Statements take a
+// contiguous range so Statement is a range check. The expression kinds tag the nodes of
+// an ExprTable, which are not Nodes.
+enum NodeKind : uint8_t {
+    NODE_PROGRAM,
+
+    NODE_EXPRESSION_STATEMENT,      // first statement
+    NODE_CODE_BLOCK,
+    NODE_LET,
+    NODE_RETURN,
+    NODE_CONDITIONAL,
+    NODE_WHILE,
+    NODE_FOR,
+    NODE_FUNCTION,                  // last statement
+
+    NODE_EMPTY,                     // first expression -- see expr_node_t
+    NODE_BINARY,
+    NODE_ASSIGNMENT,
+    NODE_INTEGER,
+    NODE_BYTE,
+    NODE_FLOAT,
+    NODE_BOOLEAN,
+    NODE_CALL,
+    NODE_IDENTIFIER,
+    NODE_VARIABLE,                  // last expression
+};
+
 // Node in the AST
+// Nodes have no vtable. The methods here look at the kind of the node and call the method
+// of the same name of its class, which every class of node defines for itself.
 class Node {
     public:
-        virtual ~Node() = default;
-        virtual void _print() {};
-        virtual void _syntax_analysis();
-        virtual void _set_parent(Node* p);
-        virtual std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) {return nullptr;}
+        NodeKind kind;
+        static bool classof(const Node *node) { return true; }
+
+        inline void _print();
+        inline void _syntax_analysis();
+        inline void _set_parent(Node* p);
+        inline SymbolTableEntry* _scope_lookup(symbol_t name);
+
+    protected:
+        Node(NodeKind kind) : kind(kind) {}
+};
+
+// isa<T>(node) -- true when the node is a T
+template <class T>
+inline bool
+isa(const Node *node) {
+    return T::classof(node);
+}
+
+// cast<T>(node) -- the node as a T, which it must be
+template <class T>
+inline T*
+cast(Node *node) {
+    assert(node != nullptr && isa<T>(node));
+    return static_cast<T*>(node);
+}
+
+// dyn_cast<T>(node) -- the node as a T, or nullptr when it is null or not a T
+template <class T>
+inline T*
+dyn_cast(Node *node) {
+    return node != nullptr && isa<T>(node) ? static_cast<T*>(node) : nullptr;
+}
+
+// Expression in an ExprTable -- the index of its node
+typedef uint32_t expr_t;
+#define EXPR_NONE UINT32_MAX    // no expression -- where an expression failed to parse
+
+// Node of an expression
+// Expressions are not Nodes: every expression of a function is a 16 byte expr_node_t in
+// the ExprTable of the function, and points at its operands by their index in the table.
+//     NODE_EMPTY       stands in for an expression that is missing, like the value of "let int x;"
+//     NODE_BINARY      infix operator "a + b" -- op, children are the operands
+//     NODE_ASSIGNMENT  "x = 3 + 20" -- op, children are the NODE_VARIABLE and the value
+//     NODE_INTEGER     integer literal like "1" or "300" -- int_value
+//     NODE_BYTE        byte literal -- int_value, just an 8 bit number for now
+//     NODE_FLOAT       floating point literal like "1.0" or "3.14" -- float_value
+//     NODE_BOOLEAN     'true' or 'false' -- int_value
+//     NODE_CALL        "add(1, 2)" -- name, children are the first of its arguments in the
+//                      table's args and how many there are
+//     NODE_IDENTIFIER  variable or function named in an expression -- name
+//     NODE_VARIABLE    variable being declared by a let statement -- name
+// The data type of a literal or variable is set by the parser, the syntax analysis works
+// out the rest.
+typedef struct ExprNode {
+    NodeKind kind;
+    uint8_t op;                 // TokenType of the operator
+    uint8_t data_type;          // DataType of the value
+    symbol_t name;              // interned name -- SYMBOL_NONE for the kinds without one
+    union {
+        expr_t children[2];     // operands -- EXPR_NONE if one failed to parse
+        int64_t int_value;
+        double float_value;
+    };
+} expr_node_t;
+
+static_assert(sizeof(expr_node_t) == 16, "expr_node_t should stay 16 bytes");
+
+// Table of the expressions of a function, or of the top level of a program
+// The nodes are in post-order: the parser adds a node once its operands are made, so
+// every operand comes before the node using it and the nodes of an expression are the
+// run of the table that ends at it. Passes over an expression scan that run from left to
+// right instead of chasing pointers down the tree.
+// The parser builds the table on the heap and copies it into the arena in one piece once
+// the function ends -- see ExprBuilder.
+class ExprTable {
+    public:
+        ArenaList <expr_node_t> nodes;  // the expressions, in post-order
+        ArenaList <expr_t> args;        // the arguments of every call, each call's in a row
+
+        expr_node_t &operator[](expr_t expr) const { return this->nodes[expr]; }
+        expr_t _first(expr_t root);                         // first node of the run ending at root
+        void _print(expr_t root);
+        DataType _syntax_analysis(expr_t root, Node *scope); // check an expression, names looked up in scope -- returns its type
 };
 
 // Statement Node
 // Does not contain a value, and excutes a command
 class Statement : public Node {
     public:
-        virtual ~Statement() = default;
-        void _print() override;
-        Node* parent;
-        void _syntax_analysis() override;
-        void _set_parent(Node* p) override {}
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-};
+        static bool classof(const Node *node) { return node->kind >= NODE_EXPRESSION_STATEMENT && node->kind <= NODE_FUNCTION; }
+        Node* parent = nullptr;
+        ExprTable* exprs = nullptr;     // table the statement's expressions are in, for a function the one of its body -- nullptr if it has none
 
-// Expression node
-// Evaluates to a value that will be held
-class Expression : public Node {
-    public:
-        Node* parent;
-        // std::shared_ptr<Node> parent;
-        DataType data_type;
-        virtual ~Expression() = default;
-        virtual DataType _get_type() {return TYPE_VOID;};
-        void _print() override;
-        void _syntax_analysis() override;
-        void _set_parent(Node* p) override {}
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
+    protected:
+        Statement(NodeKind kind) : Node(kind) {}
 };
 
 // Statement node for an expression
 // Wrapper so that something like "x + 15;" is valid code on its own
-class ExpressionStatement : public Statement {
+class ExpressionStatement final : public Statement {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_EXPRESSION_STATEMENT; }
         token_t token;                                        // first token of the expression
-        std::shared_ptr<Expression> expr; // holds the expression
+        expr_t expr; // holds the expression
 
         ExpressionStatement(
             token_t token,
-            std::shared_ptr<Expression> expr
-        ) : token(token) , expr(std::move(expr)) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        void _set_parent(Node* p) override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-};
-
-//// Expression with an infix operator
-class BinaryExpr : public Expression {
-    public:
-        token_t op;
-        std::shared_ptr<Expression> LHS;
-        std::shared_ptr<Expression> RHS;
-        BinaryExpr(
-                token_t op,
-                std::shared_ptr<Expression> LHS,
-                std::shared_ptr<Expression> RHS
-            ) : op(op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
+            ExprTable* exprs,
+            expr_t expr
+        ) : Statement(NODE_EXPRESSION_STATEMENT), token(token) , expr(expr) { this->exprs = exprs; }
+        void _print();
+        void _syntax_analysis();
+        void _set_parent(Node* p);
+        SymbolTableEntry* _scope_lookup(symbol_t name) {return nullptr;}
 };
 
 // Prefix or unary operator
@@ -100,69 +189,7 @@ class PrefixOperator {
     public:
         token_t token;
         std::string op;
-        std::shared_ptr<Expression> RHS;
-};
-
-// Node for assigning a variable
-// "x = 3 + 20"
-class VariableAssignment : public Expression {
-    public:
-    token_t op; // "="
-    std::shared_ptr<Expression> variable;
-    std::shared_ptr<Expression> RHS;
-    VariableAssignment(
-            token_t op,
-            std::shared_ptr<Expression> variable,
-            std::shared_ptr<Expression> RHS
-        ) : op(op), variable(std::move(variable)), RHS(std::move(RHS)) {}
-    void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
-};
-
-// Integer Expression Node
-// Node that is a integer literal like "1" or "300"
-class IntegerExpr : public Expression {
-    public:
-        long long value;
-        // DataType data_type = TYPE_INT;
-        IntegerExpr(long long value) : value(value) {};
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
-};
-
-// Byte Expression Node
-// Node that is a byte literal -- this is something like 'a' in the future
-//                                                                but will just be a 8 bit number for now
-class ByteExpr : public Expression {
-    public:
-        long long value;
-        // DataType data_type = TYPE_INT;
-        ByteExpr(long long value) : value(value) {};
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
-};
-
-// Float Expression Node
-// Node that is a floating point literal like "1.0" or "3.14"
-class FloatExpr : public Expression {
-    public:
-        double value;
-        // DataType data_type = TYPE_FLOAT;
-        FloatExpr(double value) : value(value) {};
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
+        expr_t RHS;
 };
 
 // Statement node for code block
@@ -170,130 +197,67 @@ class FloatExpr : public Expression {
 // {
 //     let int x = 1;
 // }
-class CodeBlock : public Statement {
+class CodeBlock final : public Statement {
     public:
-        std::vector <std::shared_ptr<Statement> > body; // the body of code of this scope
-        std::shared_ptr<SymbolTable> symbol_table;            // the symbol table of identifiers for this code block's scope
+        static bool classof(const Node *node) { return node->kind == NODE_CODE_BLOCK; }
+        ArenaList <Statement*> body; // the body of code of this scope
+        SymbolTable symbol_table;                         // the symbol table of identifiers for this code block's scope
         // std::shared_ptr<Node> parent_scope;                // the parent scope of this code block. Can be function or global scope
         Node* parent_scope;
         // add a field for an inner scope
 
-        CodeBlock() {
-            this->symbol_table = std::make_shared<SymbolTable>();
-        }
-        void _print() override;
-        void _syntax_analysis() override;
+        CodeBlock(Arena *arena) : Statement(NODE_CODE_BLOCK), symbol_table(arena), parent_scope(nullptr) {}
+        void _print();
+        void _syntax_analysis();
         void print_st();
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override; // lookup the name in the scope
-        void _set_parent(Node* p) override;
-};
-
-// Boolean Expression Node
-// Node that is a boolean value like 'true' or 'false'
-class BooleanExpr : public Expression {
-    public:
-        bool value;
-        // DataType data_type = TYPE_BOOL;
-
-        BooleanExpr(
-            bool value
-        ) : value(value) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
-};
-
-// Function Call Expression node
-// This node is for when a function is called in an expression
-// "func1(x, y);"
-// "let int x = add(1, 2) + 4;"
-class FunctionCallExpr : public Expression {
-    public:
-        std::string name;
-        std::vector <std::shared_ptr<Expression> > args;
-
-        FunctionCallExpr(
-            std::string &name,
-            std::vector <std::shared_ptr<Expression> > args
-        ) : name(name), args(std::move(args)) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
-};
-
-// Identifier class that holds the name and data type of the identifier
-// identifier can be either a function or a variable
-class IdentifierExpr : public Expression {
-    public:
-        std::string name;     // name of the identifie
-        // DataType data_type; // data type of the identifier (return type for function, stored type for variable)
-
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        std::shared_ptr<SymbolTableEntry> _get_st_entry();
-        DataType _get_type() override;
-};
-
-// Variable Expression node
-// Is an expression because a variable does contain a value that it is assigned to
-class VariableExpr : public Expression {
-    public:
-        std::string name;        // name of the variable
-        DataType data_type;    // data type of the variable -- float or int
-        Node *parent;
-
-        VariableExpr(const std::string &name, DataType data_type) : name(name), data_type(data_type) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
-        DataType _get_type() override;
+        SymbolTableEntry* _scope_lookup(symbol_t name); // lookup the name in the scope
+        void _set_parent(Node* p);
 };
 
 // Statement node for let statements for variable declaration
 // "let x = 3;"
-class LetStmt : public Statement {
+class LetStmt final : public Statement {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_LET; }
         token_t token;                                                    // "let" token
-        std::shared_ptr<Expression> variable;     // expression of the variable being declared
+        symbol_t name;            // name of the variable being declared
+        DataType data_type;       // declared type of the variable
         unsigned decl_line;                                         // the line of the statement
-        std::shared_ptr<Expression> var_assign; // expression that variable will be assigned to
+        expr_t var_assign; // NODE_ASSIGNMENT of the variable to its value
      
         LetStmt(
                 token_t token,
-                std::shared_ptr<Expression> variable,
-                std::shared_ptr<Expression> var_assign
-            ) : token(token), variable(std::move(variable)), var_assign(std::move(var_assign)) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _get_st_entry();
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
+                symbol_t name,
+                DataType data_type,
+                ExprTable* exprs,
+                expr_t var_assign
+            ) : Statement(NODE_LET), token(token), name(name), data_type(data_type), var_assign(var_assign) { this->exprs = exprs; }
+        void _print();
+        void _syntax_analysis();
+        SymbolTableEntry* _get_st_entry(Arena *arena);
+        SymbolTableEntry* _scope_lookup(symbol_t name) {return nullptr;}
+        void _set_parent(Node* p);
 };
 
 // Statement node for return statements
 // "return x + 5;"
-class ReturnStmt : public Statement {
+class ReturnStmt final : public Statement {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_RETURN; }
         token_t token;
-        class FunctionDecl* parent_func;
+        class FunctionDecl* parent_func = nullptr;
         // std::shared_ptr<class FunctionDecl> parent_func;
-        std::shared_ptr<Expression> ret_val; // return value of the function
+        expr_t ret_val; // return value of the function
         
         ReturnStmt(
             token_t token,
-            std::shared_ptr<Expression> ret_val
-        ) : token(token), ret_val(std::move(ret_val)) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
+            ExprTable* exprs,
+            expr_t ret_val
+        ) : Statement(NODE_RETURN), token(token), ret_val(ret_val) { this->exprs = exprs; }
+        void _print();
+        void _syntax_analysis();
+        SymbolTableEntry* _scope_lookup(symbol_t name) {return nullptr;}
+        void _set_parent(Node* p);
 };
 
 // Statement node for if statements
@@ -309,54 +273,58 @@ class ReturnStmt : public Statement {
 //        If the condition returns false, then we then evaluate the condition of the "alternative" field
 //        The reason that the "alternative" field is another conditional is because it allows us to chain if clauses together
 //        This is how we implement "else if" statements
-class Conditional : public Statement {
+class Conditional final : public Statement {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_CONDITIONAL; }
         token_t token;
-        std::shared_ptr<Statement> consequence;                         // body of if statement
-        std::shared_ptr<Expression> condition;                            // the condition to evaluate
-        std::shared_ptr<Statement> alternative;                         // the conditional to evaluate if the condition is not true -- this is how we do else-if
+        Statement* consequence;                         // body of if statement
+        expr_t condition;                            // the condition to evaluate
+        Statement* alternative;                         // the conditional to evaluate if the condition is not true -- this is how we do else-if
         // std::shared_ptr<Statement> parent;                                    // parent scope of the conditional
         // Statement* parent;
 
         Conditional(
             token_t token,
-            std::shared_ptr<Statement> consequence,
-            std::shared_ptr<Expression> condition,
-            std::shared_ptr<Statement> alternative
-        ) : token(token), 
-                consequence(std::move(consequence)),
-                condition(std::move(condition)),
-                alternative(std::move(alternative))
-            {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
+            Statement* consequence,
+            ExprTable* exprs,
+            expr_t condition,
+            Statement* alternative
+        ) : Statement(NODE_CONDITIONAL), token(token), 
+                consequence(consequence),
+                condition(condition),
+                alternative(alternative)
+            { this->exprs = exprs; }
+        void _print();
+        void _syntax_analysis();
+        SymbolTableEntry* _scope_lookup(symbol_t name) {return nullptr;}
+        void _set_parent(Node* p);
 };
 
 // Statement node for while loop
 // This will loop while the condition remains true and break when false
 // "while (x    < 4)..."
-class WhileLoop : public Statement {
+class WhileLoop final : public Statement {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_WHILE; }
         token_t token;
-        std::shared_ptr<Expression> condition;
-        std::shared_ptr<Statement> loop_body;
+        expr_t condition;
+        Statement* loop_body;
         // Statement* parent;
         // std::shared_ptr<Statement> parent;        // symbol table of the loop 
 
         WhileLoop(
             token_t token,
-            std::shared_ptr<Expression> condition,
-            std::shared_ptr<Statement> loop_body
-        ) : token(token), 
-                condition(std::move(condition)),
-                loop_body(std::move(loop_body))
-            {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
+            ExprTable* exprs,
+            expr_t condition,
+            Statement* loop_body
+        ) : Statement(NODE_WHILE), token(token), 
+                condition(condition),
+                loop_body(loop_body)
+            { this->exprs = exprs; }
+        void _print();
+        void _syntax_analysis();
+        SymbolTableEntry* _scope_lookup(symbol_t name) {return nullptr;}
+        void _set_parent(Node* p);
 };
 
 // Statement node for a for loop
@@ -364,82 +332,146 @@ class WhileLoop : public Statement {
 // Then check the condition, and if true it will run the loop body
 // At end of loop body, it will perform the action
 // "for (let int x = 0; x < 13; x = x + 1) {...}"
-class ForLoop : public Statement {
+class ForLoop final : public Statement {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_FOR; }
         token_t token;                                                         // the token that represents the command
-        std::shared_ptr<Statement> initialization; // the initialization statement in the for loop
-        std::shared_ptr<Expression> condition;         // the condition that the loop runs until fulfilled
-        std::shared_ptr<Expression> action;                // the action that gets taken at the end of each iteration
-        std::shared_ptr<Statement> loop_body;            // the body of the for loop
+        Statement* initialization; // the initialization statement in the for loop
+        expr_t condition;         // the condition that the loop runs until fulfilled
+        expr_t action;                // the action that gets taken at the end of each iteration
+        Statement* loop_body;            // the body of the for loop
         //std::shared_ptr<Statement> parent;                 // symbol table of the loop 
 
         ForLoop(
             token_t token,
-            std::shared_ptr<Statement> initialization,
-            std::shared_ptr<Expression> condition,
-            std::shared_ptr<Expression> action,
-            std::shared_ptr<Statement> loop_body
-        ) : token(token) , initialization(std::move(initialization)), condition(std::move(condition)) , action(std::move(action)), loop_body(std::move(loop_body)) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
+            Statement* initialization,
+            ExprTable* exprs,
+            expr_t condition,
+            expr_t action,
+            Statement* loop_body
+        ) : Statement(NODE_FOR), token(token) , initialization(initialization), condition(condition) , action(action), loop_body(loop_body) { this->exprs = exprs; }
+        void _print();
+        void _syntax_analysis();
+        SymbolTableEntry* _scope_lookup(symbol_t name) {return nullptr;}
+        void _set_parent(Node* p);
 };
 
+// Parameter of a function prototype
+typedef struct Parameter {
+    symbol_t name;
+    DataType data_type;
+} parameter_t;
+
 // Class for function prototypes
 class Prototype {
     public:
-    std::string name;
+    symbol_t name;
     DataType ret_type;
-    std::vector <IdentifierExpr> params;
+    ArenaList <parameter_t> params;
 
     Prototype(
-        std::string name,
+        symbol_t name,
         DataType ret_type,
-        std::vector <IdentifierExpr> params
-    ) : name(std::move(name)), ret_type(ret_type), params(std::move(params)) {}
+        ArenaList <parameter_t> params
+    ) : name(name), ret_type(ret_type), params(params) {}
 };
 
 // Class for function declarations
-class FunctionDecl : public Statement {
+class FunctionDecl final : public Statement {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_FUNCTION; }
         bool is_entry;                                                                 // true if it is the entry point to the program false otherwise
-        std::shared_ptr<Statement> func_body;                    // a CodeBlock that contains the body of the function
-        std::shared_ptr<Prototype> prototype;                    // the prototype of the function
+        Statement* func_body;                    // a CodeBlock that contains the body of the function
+        Prototype* prototype;                    // the prototype of the function
         // std::shared_ptr<class Program> parent;                 // parent scope of the function -- global scope
-        Program* parent;
+        Program* parent = nullptr;
+        bool reused = false;                     // spliced in from an earlier parse -- see ParseCache
+        bool checked = false;                    // the last syntax analysis of it found no errors
 
         FunctionDecl(
             bool is_entry,
-            std::shared_ptr<Statement> func_body,
-            std::shared_ptr<Prototype> prototype
-        ) : is_entry(is_entry), func_body(std::move(func_body)), prototype(std::move(prototype)) {}
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _get_st_entry();
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override {return nullptr;}
-        void _set_parent(Node* p) override;
+            Statement* func_body,
+            Prototype* prototype,
+            ExprTable* exprs
+        ) : Statement(NODE_FUNCTION), is_entry(is_entry), func_body(func_body), prototype(prototype) { this->exprs = exprs; }
+        void _print();
+        void _syntax_analysis();
+        SymbolTableEntry* _get_st_entry(Arena *arena);
+        SymbolTableEntry* _scope_lookup(symbol_t name) {return nullptr;}
+        void _set_parent(Node* p);
+        void _reparent(Program* program); // point a reused function at a new program
 };
 
 // Program Node in the AST
 // should be the root node of the tree
-class Program : public Node {
+class Program final : public Node {
     public:
+        static bool classof(const Node *node) { return node->kind == NODE_PROGRAM; }
         void assign_parents(); // top down function that cascades through all nodes and assigns parents
-        std::shared_ptr<Node> parent;
+        Node* parent = nullptr;
         FunctionDecl* entry_point; // Potentially use to define entry point of program
-        std::vector<std::shared_ptr<Statement> > statements; // top level of the program is a list of statements
-        std::shared_ptr<SymbolTable> symbol_table;                     // the symbol table for the global scope
-        void _print() override;
-        void _syntax_analysis() override;
-        std::shared_ptr<SymbolTableEntry> _scope_lookup(std::string name) override; // lookup the name in the scope
-        void _set_parent(Node* p) override {}
+        ArenaList <Statement*> statements; // top level of the program is a list of statements
+        SymbolTable symbol_table;                                       // the symbol table for the global scope
+        ExprTable* exprs = nullptr;        // expressions of the top-level statements
+        bool globals_changed = true;       // the global scope is not the one reused functions were last checked against
+        void _print();
+        void _syntax_analysis();
+        SymbolTableEntry* _scope_lookup(symbol_t name); // lookup the name in the scope
+        void _set_parent(Node* p) {}
         void _set_entry(FunctionDecl* entry_point); // set the entry point of the program
 
-        Program() {
-            this->symbol_table = std::make_shared<SymbolTable>();
+        Program(Arena *arena) : Node(NODE_PROGRAM), symbol_table(arena) {
             this->entry_point = nullptr;
         }
 };
 
+// visit(node, f) -- call f with the node as the class its kind names
+// f is usually a generic lambda, so a pass gets a direct call to the method of each class
+// -- the classes are final -- and the switch is a single jump through a table.
+// The overload for statements only switches on their kinds, so f only has to compile
+// for those classes.
+template <class F>
+inline decltype(auto)
+visit(Statement *node, F &&f) {
+    switch (node->kind) {
+        case NODE_EXPRESSION_STATEMENT: return f(static_cast<ExpressionStatement*>(node));
+        case NODE_CODE_BLOCK:           return f(static_cast<CodeBlock*>(node));
+        case NODE_LET:                  return f(static_cast<LetStmt*>(node));
+        case NODE_RETURN:               return f(static_cast<ReturnStmt*>(node));
+        case NODE_CONDITIONAL:          return f(static_cast<Conditional*>(node));
+        case NODE_WHILE:                return f(static_cast<WhileLoop*>(node));
+        case NODE_FOR:                  return f(static_cast<ForLoop*>(node));
+        case NODE_FUNCTION:
+        default:                        return f(static_cast<FunctionDecl*>(node));
+    }
+}
+
+template <class F>
+inline decltype(auto)
+visit(Node *node, F &&f) {
+    if (node->kind == NODE_PROGRAM)
+        return f(static_cast<Program*>(node));
+    return visit(static_cast<Statement*>(node), f);
+}
+
+void
+Node::_print() {
+    visit(this, [](auto *node) { node->_print(); });
+}
+
+void
+Node::_syntax_analysis() {
+    visit(this, [](auto *node) { node->_syntax_analysis(); });
+}
+
+void
+Node::_set_parent(Node* p) {
+    visit(this, [p](auto *node) { node->_set_parent(p); });
+}
+
+SymbolTableEntry*
+Node::_scope_lookup(symbol_t name) {
+    return visit(this, [name](auto *node) { return node->_scope_lookup(name); });
+}
+
 #endif /* AST_ */
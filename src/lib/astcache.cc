@@ -0,0 +1,780 @@
+#include "astcache.hh"
+#include "interner.hh"
+#include "symboltable.hh"
+#include "trace.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#define AST_CACHE_MAGIC "TBASTIMG"
+
+// Header at the start of an image
+typedef struct ImageHeader {
+    char magic[8];              // AST_CACHE_MAGIC
+    uint32_t version;           // AST_CACHE_VERSION
+    uint32_t layout;            // layout_fingerprint() of the compiler that saved it
+    uint64_t source_length;     // length of the source the AST was parsed from
+    uint64_t source_hash;       // hash_bytes() of it
+    uint64_t size;              // length of the whole image
+    uint64_t checksum;          // hash_bytes() of everything after the header
+    uint64_t root;              // offset of the AST
+    uint64_t names;             // offset of the name table -- a uint32_t length and the name for each
+    uint64_t name_count;        // number of names in the table
+} image_header_t;
+
+// Mix one more word into a hash
+static inline uint64_t
+mix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+// Hash of a source or an image
+// Four words are mixed in side by side, so a multiply does not have to wait for the one
+// before it -- an image is many MB and hashing it is part of every load
+static uint64_t
+hash_bytes(std::string_view text) {
+    uint64_t lanes[4] = {mix(0, text.length()), 1, 2, 3};
+    const char *p = text.data();
+    size_t i = 0;
+    for (; i + 32 <= text.length(); i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, p + i + lane * 8, 8);
+            lanes[lane] = mix(lanes[lane], word);
+        }
+    }
+
+    uint64_t hash = mix(mix(mix(lanes[0], lanes[1]), lanes[2]), lanes[3]);
+    for (; i + 8 <= text.length(); i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        hash = mix(hash, word);
+    }
+
+    uint64_t word = 0;
+    for (size_t shift = 0; i < text.length(); i++, shift += 8)
+        word |= (uint64_t)(unsigned char)p[i] << shift;
+    return mix(hash, word);
+}
+
+// Fingerprint of the size of every class that goes into an image
+// An image saved by a compiler whose classes are laid out differently is not loaded, even
+// when AST_CACHE_VERSION was not bumped -- as long as a size changed
+static uint32_t
+layout_fingerprint() {
+    static const size_t sizes[] = {
+        sizeof(void*), sizeof(token_t), sizeof(AST), sizeof(Program), sizeof(Prototype),
+        sizeof(SymbolTable), sizeof(SymbolTableEntry), sizeof(ExpressionStatement),
+        sizeof(CodeBlock), sizeof(LetStmt), sizeof(ReturnStmt), sizeof(Conditional),
+        sizeof(WhileLoop), sizeof(ForLoop), sizeof(FunctionDecl), sizeof(parameter_t),
+        sizeof(ExprTable), sizeof(expr_node_t),
+    };
+
+    uint64_t hash = 0;
+    for (size_t size : sizes)
+        hash = mix(hash, size);
+    return (uint32_t)hash;
+}
+
+// Pointer stored in an image -- the offset of what it points at
+template <class T>
+static inline T*
+encode(uint64_t offset) {
+    return (T*)(uintptr_t)offset;
+}
+
+// The fields of each class that point somewhere or hold a name
+// The writer and the loader both go through a class with these, so each class is only
+// described once. Everything else in an object is copied as it is.
+template <class A> static void
+fields(A &a, AST *ast) {
+    a.pointer(ast->program_node);
+}
+
+template <class A> static void
+fields(A &a, Program *node) {
+    a.pointer(node->parent);
+    a.pointer(node->entry_point);
+    a.list(node->statements);
+    a.table(node->symbol_table);
+    a.pointer(node->exprs);
+}
+
+template <class A> static void
+fields(A &a, Prototype *prototype) {
+    a.symbol(prototype->name);
+    a.list(prototype->params);
+}
+
+template <class A> static void
+fields(A &a, parameter_t *parameter) {
+    a.symbol(parameter->name);
+}
+
+template <class A> static void
+fields(A &a, SymbolTableEntry *entry) {
+    a.symbol(entry->name);
+    a.list(entry->arg_data_types);
+}
+
+template <class A> static void
+fields(A &a, ExpressionStatement *node) {
+    a.pointer(node->parent);
+    a.token(node->token);
+    a.pointer(node->exprs);
+    a.expr(node->exprs, node->expr);
+}
+
+template <class A> static void
+fields(A &a, CodeBlock *node) {
+    a.pointer(node->parent);
+    a.list(node->body);
+    a.table(node->symbol_table);
+    a.pointer(node->parent_scope);
+}
+
+template <class A> static void
+fields(A &a, LetStmt *node) {
+    a.pointer(node->parent);
+    a.token(node->token);
+    a.symbol(node->name);
+    a.pointer(node->exprs);
+    a.expr(node->exprs, node->var_assign);
+}
+
+template <class A> static void
+fields(A &a, ReturnStmt *node) {
+    a.pointer(node->parent);
+    a.token(node->token);
+    a.pointer(node->parent_func);
+    a.pointer(node->exprs);
+    a.expr(node->exprs, node->ret_val);
+}
+
+template <class A> static void
+fields(A &a, Conditional *node) {
+    a.pointer(node->parent);
+    a.token(node->token);
+    a.pointer(node->consequence);
+    a.pointer(node->exprs);
+    a.expr(node->exprs, node->condition);
+    a.pointer(node->alternative);
+}
+
+template <class A> static void
+fields(A &a, WhileLoop *node) {
+    a.pointer(node->parent);
+    a.token(node->token);
+    a.pointer(node->exprs);
+    a.expr(node->exprs, node->condition);
+    a.pointer(node->loop_body);
+}
+
+template <class A> static void
+fields(A &a, ForLoop *node) {
+    a.pointer(node->parent);
+    a.token(node->token);
+    a.pointer(node->initialization);
+    a.pointer(node->exprs);
+    a.expr(node->exprs, node->condition);
+    a.expr(node->exprs, node->action);
+    a.pointer(node->loop_body);
+}
+
+template <class A> static void
+fields(A &a, FunctionDecl *node) {
+    a.pointer(node->Statement::parent);
+    a.pointer(node->func_body);
+    a.pointer(node->prototype);
+    a.pointer(node->parent);
+    a.pointer(node->exprs);
+}
+
+// The nodes of an expression table only hold names -- their operands are indices
+template <class A> static void
+fields(A &a, ExprTable *table) {
+    a.list(table->nodes);
+    a.list(table->args);
+    a.exprs(*table);
+}
+
+template <class A> static void
+fields(A &a, expr_node_t *node) {
+    a.symbol(node->name);
+}
+
+
+/// WRITER ///
+
+// Writes the image of an AST
+// An object is copied into the image the first time something points at it, and the copy's
+// fields are rewritten later from a work list, so a deep expression does not make the
+// writer recurse as deep as it is
+class ImageWriter {
+    public:
+        typedef struct Job {
+            const char *object;     // the object in memory
+            uint64_t offset;        // its copy in the image
+            void (*run)(ImageWriter &writer, const char *object);
+        } job_t;
+
+        std::vector <char> image;
+        std::unordered_map <const void*, uint64_t> offsets;          // offset of every object copied so far
+        std::unordered_map <std::string_view, uint64_t> strings;    // offset of every literal copied so far
+        std::vector <symbol_t> names;                               // the symbols the image uses -- with repeats
+        std::vector <uint64_t> symbols;                             // offset of every name in the image
+        std::vector <job_t> work;
+        const char *object = nullptr;   // object whose fields are being rewritten
+        uint64_t object_offset = 0;     // offset of its copy
+
+        // Copy bytes to the end of the image, aligned to align
+        uint64_t append(const void *data, size_t bytes, size_t align) {
+            uint64_t offset = (this->image.size() + align - 1) & ~(uint64_t)(align - 1);
+            this->image.resize(offset + bytes);
+            memcpy(&this->image[offset], data, bytes);
+            return offset;
+        }
+
+        // Overwrite the copy of a field of the current object
+        template <class T>
+        void store(T &field, T value) {
+            this->store_at(this->object_offset + ((const char*)&field - this->object), value);
+        }
+
+        template <class T>
+        void store_at(uint64_t offset, T value) {
+            memcpy(&this->image[offset], &value, sizeof(T));
+        }
+
+        // Offset of the copy of an object -- the object is copied if it was not yet
+        template <class T>
+        uint64_t copy(T *object) {
+            static_assert(std::is_trivially_copyable<T>::value, "only plain objects can go into an image");
+
+            auto it = this->offsets.find(object);
+            if (it != this->offsets.end())
+                return it->second;
+
+            uint64_t offset = this->append(object, sizeof(T), alignof(T));
+            this->offsets[object] = offset;
+            this->work.push_back({(const char*)object, offset, [](ImageWriter &writer, const char *object) {
+                fields(writer, (T*)object);
+            }});
+            return offset;
+        }
+
+        // Offset of what a pointer points at -- 0 for nullptr
+        template <class T>
+        uint64_t target(T *object) {
+            if (object == nullptr)
+                return 0;
+            if constexpr (std::is_base_of<Node, T>::value)
+                return visit(object, [this](auto *node) { return this->copy(node); });
+            else
+                return this->copy(object);
+        }
+
+        // Rewrite the fields of every object copied, until no more are copied
+        void run() {
+            while (!this->work.empty()) {
+                job_t job = this->work.back();
+                this->work.pop_back();
+                this->object = job.object;
+                this->object_offset = job.offset;
+                job.run(*this, job.object);
+            }
+        }
+
+        template <class T>
+        void pointer(T *&field) {
+            this->store(field, encode<T>(this->target(field)));
+        }
+
+        template <class T>
+        void list(ArenaList <T> &field) {
+            if (field.count == 0) {
+                this->store(field, ArenaList<T>());
+                return;
+            }
+
+            uint64_t offset = this->append(field.items, sizeof(T) * field.count, alignof(T));
+            ArenaList <T> copied = field;
+            copied.items = encode<T>(offset);
+            this->store(field, copied);
+
+            if constexpr (std::is_pointer<T>::value) {
+                for (size_t i = 0; i < field.count; i++)
+                    this->store_at(offset + i * sizeof(T), encode<std::remove_pointer_t<T>>(this->target(field.items[i])));
+            } else if constexpr (std::is_class<T>::value) {
+                // the items are objects of their own
+                const char *object = this->object;
+                uint64_t object_offset = this->object_offset;
+                for (size_t i = 0; i < field.count; i++) {
+                    this->object = (const char*)&field.items[i];
+                    this->object_offset = offset + i * sizeof(T);
+                    fields(*this, &field.items[i]);
+                }
+                this->object = object;
+                this->object_offset = object_offset;
+            }
+        }
+
+        // The slots are copied as they are -- the loader puts the entries back where the
+        // names they have then hash to
+        void table(SymbolTable &field) {
+            uint64_t offset = 0;
+            if (field.capacity > 0)
+                offset = this->append(field.slots, sizeof(SymbolTableEntry*) * field.capacity, alignof(SymbolTableEntry*));
+            this->store(field.arena, (Arena*)nullptr);
+            this->store(field.slots, encode<SymbolTableEntry*>(offset));
+
+            for (uint32_t i = 0; i < field.capacity; i++)
+                this->store_at(offset + i * sizeof(SymbolTableEntry*), encode<SymbolTableEntry>(this->target(field.slots[i])));
+        }
+
+        void literal(std::string_view &field) {
+            uint64_t offset = 0;
+            if (!field.empty()) {
+                auto it = this->strings.find(field);
+                if (it != this->strings.end()) {
+                    offset = it->second;
+                } else {
+                    offset = this->append(field.data(), field.length(), 1);
+                    this->strings[field] = offset;
+                }
+            }
+            this->store(field, std::string_view(encode<const char>(offset), field.length()));
+        }
+
+        void token(token_t &field) {
+            this->literal(field.literal);
+            if (field.type == TOK_IDENT)
+                this->symbol(field.value.symbol);
+        }
+
+        // Expressions are copied as they are
+        void exprs(ExprTable &table) {}
+        void expr(ExprTable *table, expr_t &field) {}
+
+        // Names keep their IDs until the name table is made -- see AstImage::save()
+        void symbol(symbol_t &field) {
+            if (field == SYMBOL_NONE)
+                return;
+            this->names.push_back(field);
+            this->symbols.push_back(this->object_offset + ((const char*)&field - this->object));
+        }
+};
+
+// Write the image of a source's AST
+// It is written next to the file and renamed over it, so a build that is stopped half way
+// never leaves half an image behind
+bool
+AstImage::save(const char *path, AST *ast, std::string_view source) {
+    ImageWriter writer;
+    writer.image.resize(sizeof(image_header_t));
+
+    image_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AST_CACHE_MAGIC, sizeof(header.magic));
+    header.version = AST_CACHE_VERSION;
+    header.layout = layout_fingerprint();
+    header.source_length = source.length();
+    header.source_hash = hash_bytes(source);
+
+    header.root = writer.copy(ast);
+    writer.run();
+
+    // Every name in the image becomes its index in the name table. The names go in the
+    // order of their IDs, so a run that loads the image before it has seen any of them
+    // hands them out the IDs a parse would have.
+    std::sort(writer.names.begin(), writer.names.end());
+    writer.names.erase(std::unique(writer.names.begin(), writer.names.end()), writer.names.end());
+    for (uint64_t offset : writer.symbols) {
+        symbol_t id;
+        memcpy(&id, &writer.image[offset], sizeof(id));
+        symbol_t index = std::lower_bound(writer.names.begin(), writer.names.end(), id) - writer.names.begin();
+        writer.store_at(offset, index);
+    }
+
+    header.names = writer.image.size();
+    header.name_count = writer.names.size();
+    for (symbol_t id : writer.names) {
+        const std::string &name = symbol_name(id);
+        uint32_t length = name.length();
+        writer.append(&length, sizeof(length), 1);
+        writer.append(name.data(), length, 1);
+    }
+
+    header.size = writer.image.size();
+    header.checksum = hash_bytes(std::string_view(writer.image.data() + sizeof(header), header.size - sizeof(header)));
+    memcpy(writer.image.data(), &header, sizeof(header));
+
+    std::string temporary = std::string(path) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool written = fwrite(writer.image.data(), 1, writer.image.size(), file) == writer.image.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temporary.c_str(), path) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+
+    TRACE(TRACE_PARSER, "ast cache: saved %zu bytes to %s\n", writer.image.size(), path);
+    return true;
+}
+
+
+/// LOADER ///
+
+// Fixes up a mapped image
+// The checksum turns down an image that was damaged on disk. On top of that every offset
+// is checked against the image and every node's kind against the class of the pointer to
+// it before anything is done with it, so not even an image that was written wrong can
+// make the loader touch memory outside of it
+class ImageLoader {
+    public:
+        typedef struct Job {
+            char *object;
+            void (*run)(ImageLoader &loader, char *object);
+        } job_t;
+
+        char *base;
+        size_t size;
+        Arena *arena;                                       // arena the symbol tables grow in
+        std::vector <symbol_t> symbols;                     // ID in this run of each name of the name table
+        std::vector <uint64_t> queued;                      // bit per 8 bytes of the image -- set for every object queued
+        std::vector <SymbolTable*> tables;                  // symbol tables to put back together once the names are mapped
+        std::vector <job_t> work;
+        bool damaged = false;
+
+        ImageLoader(char *base, size_t size, Arena *arena)
+            : base(base), size(size), arena(arena), queued(size / 8 / 64 + 1, 0) {}
+
+        // count objects at an offset of the image -- nullptr if they do not fit in it
+        template <class T>
+        T *at(uint64_t offset, size_t count = 1) {
+            if (offset < sizeof(image_header_t) || offset > this->size || offset % alignof(T) != 0
+                || count > (this->size - offset) / sizeof(T)) {
+                this->damaged = true;
+                return nullptr;
+            }
+            return (T*)(this->base + offset);
+        }
+
+        // Queue the fields of an object to be fixed up -- once
+        template <class T>
+        void queue(T *object) {
+            uint64_t offset = (char*)object - this->base;
+            uint64_t bit = 1ull << (offset / 8 % 64);
+            uint64_t &word = this->queued[offset / 8 / 64];
+            if (word & bit)
+                return;
+            word |= bit;
+            this->work.push_back({(char*)object, [](ImageLoader &loader, char *object) {
+                fields(loader, (T*)object);
+            }});
+        }
+
+        // What a pointer in the image points at -- nullptr for 0 and for anything that is not a T
+        template <class T>
+        T *target(T *encoded) {
+            uint64_t offset = (uintptr_t)encoded;
+            if (offset == 0)
+                return nullptr;
+
+            if constexpr (std::is_base_of<Node, T>::value) {
+                Node *node = this->at<Node>(offset);
+                if (node == nullptr)
+                    return nullptr;
+                // every node is aligned like the pointers in it
+                if (offset % alignof(Statement) != 0 || node->kind > NODE_FUNCTION || !isa<T>(node)) {
+                    this->damaged = true;
+                    return nullptr;
+                }
+
+                // the kind tells how large the node is
+                bool fits = visit(node, [this, offset](auto *object) {
+                    object = this->at<std::remove_pointer_t<decltype(object)>>(offset);
+                    if (object != nullptr)
+                        this->queue(object);
+                    return object != nullptr;
+                });
+                return fits ? static_cast<T*>(node) : nullptr;
+            } else {
+                T *object = this->at<T>(offset);
+                if (object != nullptr)
+                    this->queue(object);
+                return object;
+            }
+        }
+
+        // Intern the names of the name table
+        bool names(uint64_t offset, uint64_t count) {
+            if (count > this->size)
+                return false;
+            this->symbols.reserve(count);
+            for (uint64_t i = 0; i < count; i++) {
+                uint32_t length;
+                if (offset > this->size || this->size - offset < sizeof(length))
+                    return false;
+                memcpy(&length, this->base + offset, sizeof(length));
+                offset += sizeof(length);
+                if (this->size - offset < length)
+                    return false;
+
+                this->symbols.push_back(intern(std::string_view(this->base + offset, length)));
+                offset += length;
+            }
+            return true;
+        }
+
+        // Fix up the fields of every object queued, until no more are queued
+        // then put the symbol tables back together
+        void run() {
+            while (!this->work.empty()) {
+                job_t job = this->work.back();
+                this->work.pop_back();
+                job.run(*this, job.object);
+            }
+
+            if (this->damaged)
+                return;
+            std::vector <SymbolTableEntry*> entries;
+            for (SymbolTable *table : this->tables) {
+                entries.clear();
+                for (uint32_t i = 0; i < table->capacity; i++) {
+                    if (table->slots[i] != nullptr)
+                        entries.push_back(table->slots[i]);
+                    table->slots[i] = nullptr;
+                }
+                table->count = 0;
+                for (SymbolTableEntry *entry : entries)
+                    table->add(entry);
+            }
+        }
+
+        template <class T>
+        void pointer(T *&field) {
+            field = this->target(field);
+        }
+
+        template <class T>
+        void list(ArenaList <T> &field) {
+            T *items = nullptr;
+            if (field.count > 0)
+                items = this->at<T>((uintptr_t)field.items, field.count);
+            if (items == nullptr) {
+                field = ArenaList<T>();
+                return;
+            }
+            field.items = items;
+
+            if constexpr (std::is_pointer<T>::value) {
+                for (size_t i = 0; i < field.count; i++)
+                    items[i] = this->target(items[i]);
+            } else if constexpr (std::is_class<T>::value) {
+                for (size_t i = 0; i < field.count; i++)
+                    fields(*this, &items[i]);
+            }
+        }
+
+        // The slots are fixed up here, but the entries only go back where their names hash
+        // to in run(), once every name has its ID
+        void table(SymbolTable &field) {
+            field.arena = this->arena;
+            SymbolTableEntry **slots = nullptr;
+            if (field.capacity > 0 && (field.capacity & (field.capacity - 1)) == 0)
+                slots = this->at<SymbolTableEntry*>((uintptr_t)field.slots, field.capacity);
+            if (slots == nullptr) {
+                this->damaged = this->damaged || field.capacity > 0;
+                field.slots = nullptr;
+                field.capacity = 0;
+                field.count = 0;
+                return;
+            }
+
+            field.slots = slots;
+            for (uint32_t i = 0; i < field.capacity; i++)
+                slots[i] = this->target(slots[i]);
+            this->tables.push_back(&field);
+        }
+
+        void literal(std::string_view &field) {
+            const char *data = nullptr;
+            if (!field.empty())
+                data = this->at<char>((uintptr_t)field.data(), field.length());
+            field = data != nullptr ? std::string_view(data, field.length()) : std::string_view();
+        }
+
+        void token(token_t &field) {
+            // the type is looked at before it is known to be one -- TOK_ENTRY is the last
+            std::underlying_type_t<TokenType> type;
+            memcpy(&type, &field.type, sizeof(type));
+            if (type > TOK_ENTRY) {
+                this->damaged = true;
+                return;
+            }
+
+            this->literal(field.literal);
+            if (field.type == TOK_IDENT)
+                this->symbol(field.value.symbol);
+        }
+
+        // Check every node of an expression table, so a pass can follow the indices in it
+        // without looking -- operands come before the node using them and are in the table
+        void exprs(ExprTable &table) {
+            if (table.nodes.count >= EXPR_NONE) {
+                this->damaged = true;
+                return;
+            }
+
+            for (expr_t i = 0; i < table.nodes.count && !this->damaged; i++) {
+                const expr_node_t &node = table.nodes[i];
+                if (node.kind < NODE_EMPTY || node.kind > NODE_VARIABLE || node.op > TOK_ENTRY || node.data_type > TYPE_VOID) {
+                    this->damaged = true;
+                    break;
+                }
+
+                expr_t first = node.children[0], count = node.children[1];
+                bool named = false;
+                switch (node.kind) {
+                    case NODE_ASSIGNMENT:
+                        if (first == EXPR_NONE)
+                            this->damaged = true;
+                        // fall through
+                    case NODE_BINARY:
+                        for (expr_t operand : node.children)
+                            this->damaged = this->damaged || (operand != EXPR_NONE && operand >= i);
+                        break;
+                    case NODE_CALL:
+                        named = true;
+                        if (count > table.args.count || first > table.args.count - count) {
+                            this->damaged = true;
+                            break;
+                        }
+                        for (expr_t arg = first; arg < first + count; arg++)
+                            this->damaged = this->damaged || table.args[arg] >= i;
+                        break;
+                    case NODE_IDENTIFIER:
+                    case NODE_VARIABLE:
+                        named = true;
+                        break;
+                    default:
+                        break;
+                }
+
+                // calls, identifiers and variables are printed and looked up by their name
+                if (named && node.name == SYMBOL_NONE)
+                    this->damaged = true;
+            }
+        }
+
+        // The root of an expression has to be in the table -- its nodes are checked with it
+        void expr(ExprTable *table, expr_t &field) {
+            if (field != EXPR_NONE && (table == nullptr || field >= table->nodes.count))
+                this->damaged = true;
+        }
+
+        void symbol(symbol_t &field) {
+            if (field == SYMBOL_NONE)
+                return;
+            if (field >= this->symbols.size()) {
+                this->damaged = true;
+                return;
+            }
+            field = this->symbols[field];
+        }
+};
+
+// Constructor -- nothing is loaded yet
+AstImage::AstImage() {
+    this->base = nullptr;
+    this->size = 0;
+    this->ast = nullptr;
+}
+
+// Destructor -- unmap the image, which frees the AST in it
+AstImage::~AstImage() {
+    this->unload();
+}
+
+void
+AstImage::unload() {
+    if (this->base != nullptr)
+        munmap(this->base, this->size);
+    this->base = nullptr;
+    this->size = 0;
+    this->ast = nullptr;
+    this->arena.reset();
+}
+
+// Map the image of a source and fix it up
+// Returns false if the file cannot be read, was saved from another source or by a
+// compiler with other classes, or is damaged -- the source has to be parsed then
+bool
+AstImage::load(const char *path, std::string_view source) {
+    this->unload();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(image_header_t)) {
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+    this->base = (char*)mapped;
+    this->size = st.st_size;
+
+    image_header_t header;
+    memcpy(&header, this->base, sizeof(header));
+    if (memcmp(header.magic, AST_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != AST_CACHE_VERSION
+        || header.layout != layout_fingerprint()
+        || header.size != this->size
+        || header.source_length != source.length()
+        || header.source_hash != hash_bytes(source)) {
+        TRACE(TRACE_PARSER, "ast cache: %s is not an image of this source\n", path);
+        this->unload();
+        return false;
+    }
+    if (header.checksum != hash_bytes(std::string_view(this->base + sizeof(header), this->size - sizeof(header)))) {
+        TRACE(TRACE_PARSER, "ast cache: %s is damaged\n", path);
+        this->unload();
+        return false;
+    }
+
+    ImageLoader loader(this->base, this->size, &this->arena);
+    if (!loader.names(header.names, header.name_count)) {
+        TRACE(TRACE_PARSER, "ast cache: %s is damaged\n", path);
+        this->unload();
+        return false;
+    }
+
+    AST *ast = loader.target(encode<AST>(header.root));
+    loader.run();
+    if (ast == nullptr || ast->program_node == nullptr || loader.damaged) {
+        TRACE(TRACE_PARSER, "ast cache: %s is damaged\n", path);
+        this->unload();
+        return false;
+    }
+
+    TRACE(TRACE_PARSER, "ast cache: loaded %zu bytes from %s\n", this->size, path);
+    this->ast = ast;
+    return true;
+}
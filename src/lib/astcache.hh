@@ -0,0 +1,52 @@
+/*
+ *    astcache.hh
+ *
+ *    This file contains the on-disk image of a parsed AST, so a source
+ *    that did not change since the last build is neither lexed nor parsed
+ *
+ */
+
+#pragma once
+#ifndef AST_CACHE_
+#define AST_CACHE_
+
+#include <cstdint>
+#include <string_view>
+
+#include "arena.hh"
+#include "ast.hh"
+
+// Version of the image format -- bump it whenever a class that goes into the image changes
+#define AST_CACHE_VERSION 2
+
+// AST image
+// A file holding the AST of one source, symbol tables and all, laid out the way the nodes
+// are in memory. Every pointer in it is the offset of what it points at from the start of
+// the file and every name is the symbol ID it had when the image was saved, followed by
+// a table of those names. Token literals are copied into the file, so the image does not
+// point into the source at all.
+// Loading maps the file and fixes it up in place: offsets become pointers again and the
+// names are interned, which gives them the IDs of this run. The mapping is private, so
+// the fix-up only writes to copies of the pages it touches and the file stays the same.
+// An image is only loaded for the exact source it was saved from -- the header holds the
+// length and a hash of the source.
+class AstImage {
+    public:
+        char *base;         // start of the mapped file -- nullptr until an image is loaded
+        size_t size;        // length of the mapped file
+        Arena arena;        // the symbol tables of the loaded AST grow in here
+        AST *ast;           // the loaded AST -- points into the mapping. DO NOT FREE
+
+        AstImage();
+        ~AstImage();
+        AstImage(const AstImage&) = delete;
+        AstImage& operator=(const AstImage&) = delete;
+
+        bool load(const char *path, std::string_view source); // false if there is no image of the source or it is damaged
+        static bool save(const char *path, AST *ast, std::string_view source); // false if the file could not be written
+
+    private:
+        void unload();
+};
+
+#endif /* AST_CACHE_ */
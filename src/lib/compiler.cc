@@ -7,28 +7,38 @@
 #include "compiler.hh"
 
 // Constructor for the compiler
-Compiler::Compiler(std::string input_text) {
-  this->input = input_text;
-  printf("--- INPUT ---\n%s\n------------\n", this->input.c_str());
-  this->symbol_table = new SymbolTable();
-  this->error_handler = new ErrorHandler();
+// With a cache, the functions that did not change since the last compile are not parsed again
+Compiler::Compiler(SourceBuffer *source, ParseCache *cache) {
+  this->source = source;
+  this->cache = cache;
+  this->ast_cache = nullptr;
+  this->image = nullptr;
+  this->parser = nullptr;
+  printf("--- INPUT ---\n" SV_FMT "\n------------\n", SV_ARG(this->source->text()));
+  this->arena = new Arena();
+  this->symbol_table = new SymbolTable(this->arena);
+  this->error_handler = new ErrorHandler(this->source->text());
 
-  this->preprocessor = new Preprocessor(this->input);
-  printf("----\n%s\n-----\n", this->preprocessor->process().c_str());
-  this->lexer = new Lexer(this->preprocessor->process());
-  // this->lexer = new Lexer(this->input);
+  // The lexer skips comments and hands directives to the preprocessor as it goes,
+  // so the source is only read once and never rewritten
+  this->preprocessor = new Preprocessor(this->source);
+  this->lexer = new Lexer(this->source->text());
 
   // Point the lexer's error handler to the compiler's
   this->lexer->error_handler = this->error_handler;
+  this->lexer->preprocessor = this->preprocessor;
 }
 
 // Destructor for the compiler
 Compiler::~Compiler() {
+  delete this->image;
   delete this->parser;
   delete this->lexer;
   delete this->symbol_table;
   delete this->error_handler;
   delete this->preprocessor;
+  delete this->arena;
+  delete this->source;
 }
 
 void
@@ -37,15 +47,53 @@ Compiler::test_lexer() {
 }
 
 // Function to test the parser
+// The parser pulls tokens from the lexer as it goes, so the token stream is never stored
+// With a cache the whole source is lexed first, since only the functions can be found
+// before they are parsed, and the arena and source are handed to the cache at the end
+// With an AST cache file, a source that did not change since the file was saved is not
+// lexed or parsed at all, and one that did is saved to it once it parses without errors
 void
 Compiler::test_parser() {
-  this->lexer->tokenize_input();
-  std::vector<token_t> tokens = this->lexer->tokens;
-  this->parser = new Parser(tokens);
-  this->parser->error_handler = this->error_handler;
-  this->parser->symbol_table = this->symbol_table;
-  std::shared_ptr<AST> ast = this->parser->_create_ast();
+  AST *ast = nullptr;
+  if (this->ast_cache != nullptr) {
+    this->image = new AstImage();
+    if (this->image->load(this->ast_cache, this->source->text())) {
+      ast = this->image->ast;
+    } else {
+      delete this->image;
+      this->image = nullptr;
+    }
+  }
+
+  if (ast == nullptr) {
+    if (this->cache != nullptr) {
+      this->lexer->tokenize_input();
+      this->parser = new Parser(this->lexer->tokens);
+      this->parser->cache = this->cache;
+    } else {
+      this->parser = new Parser(this->lexer);
+    }
+    this->parser->error_handler = this->error_handler;
+    this->parser->symbol_table = this->symbol_table;
+    this->parser->arena = this->arena;
+    ast = this->parser->_create_ast();
+
+    if (this->ast_cache != nullptr && this->error_handler->error_log.empty())
+      AstImage::save(this->ast_cache, ast, this->source->text());
+  }
+
+  // The parser itself prints nothing, so show what it built
+  printf(" -- Program --\n");
+  ast->program_node->_print();
+  ast->program_node->symbol_table.print_elements();
+
   ast->_syntax_analysis();
 
   this->error_handler->print_errors();
+
+  if (this->cache != nullptr && this->parser != nullptr) {
+    this->cache->keep(this->arena, this->source);
+    this->arena = nullptr;
+    this->source = nullptr;
+  }
 }
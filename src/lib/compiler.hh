@@ -5,25 +5,33 @@
 #include <string>
 
 #include "token.hh"
+#include "arena.hh"
+#include "astcache.hh"
 #include "lexer.hh"
 #include "parser.hh"
+#include "parsecache.hh"
 #include "symboltable.hh"
 #include "errorhandler.hh"
 #include "preprocessor.hh"
+#include "sourcebuffer.hh"
 
 class Compiler {
     public:
         // Member Variables
-        std::string input; // this will eventually change to list of files or whatever module system is
+        SourceBuffer *source; // the source code of the input file -- this will eventually change to list of files or whatever module system is
+        Arena *arena;         // owns the AST and the symbol tables -- all of it is freed at once with the compiler
         SymbolTable *symbol_table;
         ErrorHandler *error_handler;
+        ParseCache *cache;    // earlier compiles of the same source -- nullptr parses everything. DO NOT FREE
+        const char *ast_cache; // file the AST is kept in between runs -- nullptr for none. DO NOT FREE
+        AstImage *image;      // the AST loaded from ast_cache -- nullptr when the source was parsed
 
         Preprocessor *preprocessor;
         Lexer *lexer;
         Parser *parser;
     
         // Member Functions
-        Compiler(std::string source_code);
+        Compiler(SourceBuffer *source, ParseCache *cache = nullptr); // takes ownership of the source buffer
         ~Compiler();
 
         void test_lexer();
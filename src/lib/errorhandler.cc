@@ -1,10 +1,19 @@
 #include "errorhandler.hh"
+#include "sourcefiles.hh"
 
 // Prints out all the errors that the compiler caught
+// Errors in an included file are prefixed with the file's path
 void
 ErrorHandler::print_errors() {
     for (size_t i = 0; i < this->error_log.size(); i++) {
-        printf("Line %lu: %s\n", this->error_log[i].line_num, this->error_log[i].message.c_str());
+        std::string path;
+        source_location_t loc;
+        if (source_files.locate(this->error_log[i].offset, &path, &loc))
+            printf("%s: Line %zu:%zu: %s\n", path.c_str(), loc.line, loc.column, this->error_log[i].message.c_str());
+        else {
+            loc = this->lines.locate(this->error_log[i].offset);
+            printf("Line %zu:%zu: %s\n", loc.line, loc.column, this->error_log[i].message.c_str());
+        }
     }
 
     if (this->error_log.size() == 0) {
@@ -14,7 +23,17 @@ ErrorHandler::print_errors() {
 
 // Creates a new error and appends it to the error log
 void
-ErrorHandler::new_error(size_t line_num, std::string message) {
-    ErrorLogEntry err = ErrorLogEntry(line_num, message);
+ErrorHandler::new_error(uint32_t offset, std::string message) {
+    ErrorLogEntry err = ErrorLogEntry(offset, message);
     this->error_log.push_back(err);
 }
+
+// Line number of an offset for diagnostics
+size_t
+ErrorHandler::line(uint32_t offset) {
+    std::string path;
+    source_location_t loc;
+    if (source_files.locate(offset, &path, &loc))
+        return loc.line;
+    return this->lines.line(offset);
+}
@@ -2,21 +2,25 @@
 #define ERROR_LOG
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "linetable.hh"
 #include "token.hh"
 
 // An entry in the error log
+// Errors only store the offset in the source they happened at, the line and column are
+// worked out when the errors are printed
 class ErrorLogEntry {
     public:
-        size_t line_num;
+        uint32_t offset;
         std::string message;
         
         ErrorLogEntry (
-            size_t line_num,
+            uint32_t offset,
             std::string message
-        ) : line_num(line_num), message(message) {}
+        ) : offset(offset), message(message) {}
 };
 
 // Error handler class
@@ -24,8 +28,14 @@ class ErrorLogEntry {
 class ErrorHandler {
     public:
         std::vector <ErrorLogEntry> error_log;
+        LineTable lines;        // line index of the source the errors are reported against
+
+        ErrorHandler() {}
+        ErrorHandler(std::string_view source) : lines(source) {}
+
         void print_errors();
-        void new_error(size_t line_num, std::string message);
+        void new_error(uint32_t offset, std::string message);
+        size_t line(uint32_t offset); // line number of an offset for diagnostics
 };
 
 #endif /* ERROR_LOG */
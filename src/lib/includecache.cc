@@ -0,0 +1,76 @@
+#include "includecache.hh"
+#include "lexer.hh"
+#include "preprocessor.hh"
+#include "sourcefiles.hh"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+IncludeCache include_cache;
+
+// Get the lexed tokens of a file
+// The file is lexed with a preprocessor of its own, so its aliases only apply inside
+// of it. The $includes in it are recorded in the entry instead of being followed.
+// The lock is held while a file is lexed, which is fine since lexing one never loads another.
+const included_file_t*
+IncludeCache::load(const std::string &path, std::string *error) {
+    char resolved[PATH_MAX];
+    struct stat st;
+    if (realpath(path.c_str(), resolved) == nullptr || stat(resolved, &st) != 0) {
+        *error = strerror(errno);
+        return nullptr;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        *error = "not a regular file";
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    auto it = this->files.find(resolved);
+    if (it != this->files.end()) {
+        const included_file_t *file = it->second;
+        if (file->mtime.tv_sec == st.st_mtim.tv_sec && file->mtime.tv_nsec == st.st_mtim.tv_nsec
+                && file->source->length == (size_t)st.st_size) {
+            this->hits++;
+            return file;
+        }
+    }
+
+    SourceBuffer *source = new SourceBuffer();
+    if (!source->load_file(resolved)) {
+        delete source;
+        *error = "cannot read the file";
+        return nullptr;
+    }
+
+    uint32_t base = source_files.add(resolved, source->text());
+    if (base == 0) {
+        delete source;
+        *error = "too much included source";
+        return nullptr;
+    }
+
+    // a stale entry is replaced but not freed, a lexer could still be reading it
+    included_file_t *file = new included_file_t;
+    file->path = resolved;
+    file->mtime = st.st_mtim;
+    file->source = source;
+
+    ErrorHandler errors;
+    Preprocessor preprocessor(source);
+    Lexer lexer(source->text(), base);
+    lexer.error_handler = &errors;
+    lexer.preprocessor = &preprocessor;
+    lexer.include_points = &file->includes;
+    lexer.tokenize_input();
+
+    file->tokens = std::move(lexer.tokens);
+    file->errors = std::move(errors.error_log);
+    this->files[resolved] = file;
+    this->misses++;
+    return file;
+}
@@ -0,0 +1,62 @@
+/*
+ *    includecache.hh
+ *
+ *    This file contains the process-wide cache of the files
+ *    pulled in with $include, lexed once each
+ *
+ */
+
+#pragma once
+#ifndef INCLUDE_CACHE_
+#define INCLUDE_CACHE_
+
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "errorhandler.hh"
+#include "sourcebuffer.hh"
+#include "tokenbuffer.hh"
+
+// An $include found while lexing a file for the cache
+// It is not followed then -- whether it pulls anything in depends on what the
+// compilation including the file has already included
+typedef struct IncludePoint {
+    size_t token;       // index of the token the included file goes in front of
+    uint32_t offset;    // offset of the $include, for errors
+    std::string path;   // the file name resolved against the including file's directory
+} include_point_t;
+
+// A lexed included file
+// Its tokens have its own aliases expanded and carry offsets in the range the
+// registry of source files gave it. Never freed -- lexers hold on to them.
+typedef struct IncludedFile {
+    std::string path;                       // canonical path
+    struct timespec mtime;                  // modification time when it was lexed
+    SourceBuffer *source;                   // the file's source -- the tokens point into it
+    TokenBuffer tokens;                     // every token of the file, TOK_EOF last
+    std::vector <include_point_t> includes; // the $includes in the file, in order
+    std::vector <ErrorLogEntry> errors;     // errors found lexing the file
+} included_file_t;
+
+// Include cache
+// Files are keyed on their canonical path, so every name a file is included by
+// finds the same entry. An entry is reused for as long as the file's mtime and
+// size are unchanged, otherwise the file is read and lexed again.
+class IncludeCache {
+    public:
+        std::mutex lock;
+        std::unordered_map <std::string, included_file_t*> files;
+        size_t hits;        // loads answered from the cache
+        size_t misses;      // loads that read and lexed the file
+
+        IncludeCache() : hits(0), misses(0) {}
+
+        const included_file_t *load(const std::string &path, std::string *error); // nullptr with the reason in error if the file cannot be read
+};
+
+extern IncludeCache include_cache;
+
+#endif /* INCLUDE_CACHE_ */
@@ -0,0 +1,69 @@
+#include "interner.hh"
+
+#include <cstring>
+
+#define INTERNER_INITIAL_SLOTS 1024
+
+Interner interner;
+
+// Constructor
+Interner::Interner() {
+    this->slots.assign(INTERNER_INITIAL_SLOTS, slot_t{0, SYMBOL_NONE});
+}
+
+// Get the ID of a name whose hash is already known
+// The first time a name is seen it is copied into the interner and gets the next ID
+symbol_t
+Interner::intern(std::string_view name, uint32_t hash) {
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    size_t mask = this->slots.size() - 1;
+    size_t i = hash & mask;
+    for (; this->slots[i].id != SYMBOL_NONE; i = (i + 1) & mask) {
+        if (this->slots[i].hash == hash && this->names[this->slots[i].id] == name)
+            return this->slots[i].id;
+    }
+
+    symbol_t id = (symbol_t)this->names.size();
+    this->names.emplace_back(name);
+    this->slots[i] = slot_t{hash, id};
+
+    // keep the table at most half full so probe chains stay short
+    if (this->names.size() * 2 > this->slots.size())
+        this->grow();
+
+    return id;
+}
+
+// Double the size of the hash table and put every ID back in
+void
+Interner::grow() {
+    std::vector <slot_t> old = std::move(this->slots);
+    this->slots.assign(old.size() * 2, slot_t{0, SYMBOL_NONE});
+
+    size_t mask = this->slots.size() - 1;
+    for (const slot_t &slot : old) {
+        if (slot.id == SYMBOL_NONE)
+            continue;
+
+        size_t i = slot.hash & mask;
+        while (this->slots[i].id != SYMBOL_NONE)
+            i = (i + 1) & mask;
+        this->slots[i] = slot;
+    }
+}
+
+// Get the name that an ID stands for
+// The reference stays valid -- names are never moved or removed
+const std::string&
+Interner::name(symbol_t id) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->names[id];
+}
+
+// Number of names in the interner
+size_t
+Interner::size() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->names.size();
+}
@@ -0,0 +1,117 @@
+/*
+ *    interner.hh
+ *
+ *    This file contains the string interner that gives every
+ *    identifier name a small integer ID
+ *
+ */
+
+#pragma once
+#ifndef INTERNER_
+#define INTERNER_
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// ID of an interned name -- two names are equal exactly when their IDs are
+typedef uint32_t symbol_t;
+
+// Hash of a name -- the interner and the symbol caches in front of it share it
+// The name is hashed 8 bytes at a time, most identifiers fit in one or two words
+inline uint32_t
+hash_name(std::string_view name) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    const char *p = name.data();
+    size_t length = name.length();
+    uint64_t hash = length * k;
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        hash = (hash ^ word) * k;
+        hash ^= hash >> 32;
+    }
+
+    uint64_t word = 0;
+    for (size_t shift = 0; i < length; i++, shift += 8)
+        word |= (uint64_t)(unsigned char)p[i] << shift;
+    hash = (hash ^ word) * k;
+
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// String interner
+// The lexer interns every identifier as it reads it, and everything after the lexer
+// (the parser, the AST and the symbol tables) carries the ID instead of the name.
+// Names are never removed, so an ID and the string it stands for stay valid for the whole
+// run of the program. All the members are guarded by 'lock' so the lexer threads can share it.
+class Interner {
+    public:
+        // A slot of the open addressing table -- the hash is kept so most probes never touch the name
+        typedef struct Slot {
+            uint32_t hash;
+            symbol_t id;        // SYMBOL_NONE if the slot is empty
+        } slot_t;
+
+        std::mutex lock;
+        std::deque <std::string> names;     // the name of every ID -- names[id]. A deque never moves its elements
+        std::vector <slot_t> slots;         // hash table from name to ID -- its size is a power of 2
+
+        Interner();
+        symbol_t intern(std::string_view name) { return this->intern(name, hash_name(name)); }
+        symbol_t intern(std::string_view name, uint32_t hash); // ID of the name, adding it if it is new
+        const std::string &name(symbol_t id);                  // name an ID stands for
+        size_t size();                                         // number of names interned so far
+
+    private:
+        void grow();
+};
+
+#define SYMBOL_NONE UINT32_MAX
+
+// The interner shared by the whole compiler
+extern Interner interner;
+
+// Shorthands for the shared interner
+inline symbol_t intern(std::string_view name) { return interner.intern(name); }
+inline const std::string &symbol_name(symbol_t id) { return interner.name(id); }
+
+// Number of entries in a symbol cache -- must be a power of 2
+#define SYMBOL_CACHE_SIZE 512
+
+// Symbol cache
+// A small direct mapped cache in front of the shared interner for a single thread.
+// Source code uses the same few names over and over, so most identifiers are found
+// here without taking the interner's lock. The cached names are the strings the cache
+// was asked about, so they have to outlive it -- the lexer's cache points into its input.
+class SymbolCache {
+    public:
+        typedef struct Entry {
+            std::string_view name;
+            symbol_t id = SYMBOL_NONE;
+        } entry_t;
+
+        entry_t entries[SYMBOL_CACHE_SIZE];
+
+        // Get the ID of a name through the cache
+        // A miss goes to the shared interner and replaces whatever was in the entry
+        symbol_t intern(std::string_view name) {
+            uint32_t hash = hash_name(name);
+            entry_t &entry = this->entries[hash & (SYMBOL_CACHE_SIZE - 1)];
+            if (entry.name.length() == name.length() && entry.id != SYMBOL_NONE
+                && memcmp(entry.name.data(), name.data(), name.length()) == 0)
+                return entry.id;
+
+            entry.id = interner.intern(name, hash);
+            entry.name = name;
+            return entry.id;
+        }
+};
+
+#endif /* INTERNER_ */
@@ -1,43 +1,169 @@
 #include "lexer.hh"
 #include "token.hh"
-#include <cctype>
+#include "scan.hh"
+#include "interner.hh"
+#include "trace.hh"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Key used to dispatch keyword lookups on the length and first character of an identifier
+// Every keyword has a unique key except "byte" and "bool"
+static constexpr unsigned
+keyword_key(size_t length, char first) {
+    return (unsigned)(length << 8) | (unsigned char)first;
+}
+
+// Classify an identifier as a keyword or a plain identifier
+// The keyword set is fixed (see docs/keywords.txt), so a switch on the length and first
+// character narrows every lookup to at most two string compares without building any table
+static constexpr TokenType
+keyword_type(std::string_view ident) {
+    if (ident.empty())
+        return TOK_IDENT;
+
+    switch (keyword_key(ident.size(), ident[0])) {
+        case keyword_key(2, 'i'): return ident == "if" ? TOK_IF : TOK_IDENT;
+        case keyword_key(3, 'l'): return ident == "let" ? TOK_LET : TOK_IDENT;
+        case keyword_key(3, 'i'): return ident == "int" ? TOK_TYPEINT : TOK_IDENT;
+        case keyword_key(3, 'f'): return ident == "for" ? TOK_FOR : TOK_IDENT;
+        case keyword_key(4, 'b'):
+            if (ident == "byte") return TOK_TYPEBYTE;
+            return ident == "bool" ? TOK_TYPEBOOL : TOK_IDENT;
+        case keyword_key(4, 'v'): return ident == "void" ? TOK_VOID : TOK_IDENT;
+        case keyword_key(4, 'e'): return ident == "else" ? TOK_ELSE : TOK_IDENT;
+        case keyword_key(4, 't'): return ident == "true" ? TOK_TRUE : TOK_IDENT;
+        case keyword_key(5, 'f'):
+            if (ident == "float") return TOK_TYPEFLOAT;
+            return ident == "false" ? TOK_FALSE : TOK_IDENT;
+        case keyword_key(5, 'w'): return ident == "while" ? TOK_WHILE : TOK_IDENT;
+        case keyword_key(5, 'e'): return ident == "entry" ? TOK_ENTRY : TOK_IDENT;
+        case keyword_key(6, 'd'): return ident == "define" ? TOK_FUNCTION : TOK_IDENT;
+        case keyword_key(6, 'r'): return ident == "return" ? TOK_RETURN : TOK_IDENT;
+        case keyword_key(6, 's'): return ident == "string" ? TOK_STRING : TOK_IDENT;
+        case keyword_key(8, 'f'): return ident == "function" ? TOK_FUNCTION : TOK_IDENT;
+        case keyword_key(10, 'h'): return ident == "henceforth" ? TOK_LET : TOK_IDENT;
+        default: return TOK_IDENT;
+    }
+}
+
+// Character classes the lexer dispatches on
+enum CharClass : uint8_t {
+    CHAR_ILLEGAL,     // cannot start a token
+    CHAR_END,         // '\0' -- end of the input
+    CHAR_WHITESPACE,  // ' ' '\t' '\r' '\n'
+    CHAR_ALPHA,       // starts an identifier or keyword
+    CHAR_DIGIT,       // starts a number
+    CHAR_OPERATOR,    // starts an operator or punctuation -- see operator_table
+};
+
+// Transitions out of the first character of an operator
+typedef struct OperatorEntry {
+    TokenType single;       // token when the character stands alone
+    TokenType with_equals;  // token when the character is followed by '=' -- TOK_ILLEGAL if there is none
+} operator_entry_t;
+
+typedef struct CharClassTable {
+    CharClass entries[256];
+    constexpr CharClass operator[](unsigned char c) const { return entries[c]; }
+} char_class_table_t;
+
+typedef struct OperatorTable {
+    operator_entry_t entries[256];
+    constexpr const operator_entry_t& operator[](unsigned char c) const { return entries[c]; }
+} operator_table_t;
+
+static constexpr operator_table_t
+make_operator_table() {
+    operator_table_t table = {};
+    for (int c = 0; c < 256; c++)
+        table.entries[c] = { TOK_ILLEGAL, TOK_ILLEGAL };
+
+    table.entries[(unsigned char)';'] = { TOK_SEMICOLON, TOK_ILLEGAL };
+    table.entries[(unsigned char)','] = { TOK_COMMA, TOK_ILLEGAL };
+    table.entries[(unsigned char)'('] = { TOK_LPAREN, TOK_ILLEGAL };
+    table.entries[(unsigned char)')'] = { TOK_RPAREN, TOK_ILLEGAL };
+    table.entries[(unsigned char)'{'] = { TOK_LBRACE, TOK_ILLEGAL };
+    table.entries[(unsigned char)'}'] = { TOK_RBRACE, TOK_ILLEGAL };
+    table.entries[(unsigned char)'['] = { TOK_LBRACKET, TOK_ILLEGAL };
+    table.entries[(unsigned char)']'] = { TOK_RBRACKET, TOK_ILLEGAL };
+    table.entries[(unsigned char)'='] = { TOK_EQUALS, TOK_EQUALTO };
+    table.entries[(unsigned char)'+'] = { TOK_PLUS, TOK_PLUS_EQUAL };
+    table.entries[(unsigned char)'-'] = { TOK_MINUS, TOK_MINUS_EQUAL };
+    table.entries[(unsigned char)'*'] = { TOK_ASTERISK, TOK_TIMES_EQUAL };
+    table.entries[(unsigned char)'/'] = { TOK_SLASH, TOK_DIV_EQUAL };
+    table.entries[(unsigned char)'%'] = { TOK_MOD, TOK_MOD_EQUAL };
+    table.entries[(unsigned char)'!'] = { TOK_BANG, TOK_NOTEQUALTO };
+    table.entries[(unsigned char)'<'] = { TOK_LT, TOK_LTEQUALTO };    // future: '<<' for bitshifting
+    table.entries[(unsigned char)'>'] = { TOK_GT, TOK_GTEQUALTO };    // future: '>>' for bitshifting
+    return table;
+}
+
+static constexpr operator_table_t operator_table = make_operator_table();
+
+static constexpr char_class_table_t
+make_char_classes() {
+    char_class_table_t table = {};
+    for (int c = 0; c < 256; c++) {
+        if (operator_table.entries[c].single != TOK_ILLEGAL)
+            table.entries[c] = CHAR_OPERATOR;
+        else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            table.entries[c] = CHAR_ALPHA;
+        else if (c >= '0' && c <= '9')
+            table.entries[c] = CHAR_DIGIT;
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            table.entries[c] = CHAR_WHITESPACE;
+        else if (c == '\0')
+            table.entries[c] = CHAR_END;
+        else
+            table.entries[c] = CHAR_ILLEGAL;
+    }
+    return table;
+}
+
+static constexpr char_class_table_t char_classes = make_char_classes();
+
+static_assert(keyword_type("henceforth") == TOK_LET, "keyword table out of sync");
+static_assert(keyword_type("bool") == TOK_TYPEBOOL, "keyword table out of sync");
+static_assert(keyword_type("false") == TOK_FALSE, "keyword table out of sync");
+static_assert(keyword_type("fort") == TOK_IDENT, "keyword table out of sync");
 
 // Constructor
-Lexer::Lexer(std::string input) {
-    this->line_num = 1;
+Lexer::Lexer(std::string_view input, uint32_t base) {
     this->input = input;
+    this->base = base;
+    this->tokens.source = input;
+    this->tokens.base = base;
+    this->error_handler = nullptr;
+    this->preprocessor = nullptr;
+    this->include_points = nullptr;
+    this->expansion_position = 0;
     this->read_position = 0;
     this->position = 0;
     this->read_char();
-
-    this->keywords["function"] = TOK_FUNCTION;
-    this->keywords["define"] = TOK_FUNCTION;
-    this->keywords["return"] = TOK_RETURN;
-    this->keywords["let"] = TOK_LET;
-    this->keywords["henceforth"] = TOK_LET;
-    this->keywords["int"] = TOK_TYPEINT;
-    this->keywords["float"] = TOK_TYPEFLOAT;
-    this->keywords["byte"] = TOK_TYPEBYTE;
-    this->keywords["bool"] = TOK_TYPEBOOL;
-    this->keywords["void"] = TOK_VOID;
-    this->keywords["string"] = TOK_STRING;
-    this->keywords["if"] = TOK_IF;
-    this->keywords["else"] = TOK_ELSE;
-    this->keywords["while"] = TOK_WHILE;
-    this->keywords["for"] = TOK_FOR;
-    this->keywords["true"] = TOK_TRUE;
-    this->keywords["false"] = TOK_FALSE;
-    this->keywords["entry"] = TOK_ENTRY;
 }
 
 
 // Copy constructor
 Lexer::Lexer(Lexer &l) {
     input = l.input;
-    keywords = l.keywords;
+    base = l.base;
+    tokens.source = l.input;
+    tokens.base = l.base;
     position = l.position;
     read_position = l.read_position;
     cur_char = l.cur_char;
+    error_handler = l.error_handler;
+    preprocessor = l.preprocessor;
+    expansion = l.expansion;
+    expansion_position = l.expansion_position;
+    includes = l.includes;
+    include_points = l.include_points;
 }
 
 // Iterate over entire input and create a token stream
@@ -46,198 +172,234 @@ Lexer::tokenize_input() {
     token_t tok;
     while (tok.type != TOK_EOF) {
         tok = this->next_token();
+        this->tokens.push(tok);
+    }
+}
+
+// Find the first place at or after 'target' that starts a line outside of a comment
+// 'from' has to be outside of a comment itself. Only the '/' characters in between are
+// looked at, so this runs at memchr speed. Returns the length of the input if there is none.
+static size_t
+next_line_outside_comment(std::string_view input, size_t from, size_t target) {
+    const char *data = input.data();
+    size_t length = input.length();
+    size_t pos = from;
+
+    while (pos < length) {
+        const char *slash = (const char*)memchr(data + pos, '/', length - pos);
+        size_t comment = (slash == nullptr) ? length : slash - data;
+
+        // a newline past the target before the next comment is the answer
+        size_t search = pos > target ? pos : target;
+        if (search < comment) {
+            const char *newline = (const char*)memchr(data + search, '\n', comment - search);
+            if (newline != nullptr)
+                return newline - data + 1;
+        }
+        if (comment + 1 >= length)
+            return length;
+
+        if (data[comment + 1] == '/') {
+            const char *newline = (const char*)memchr(data + comment, '\n', length - comment);
+            if (newline == nullptr)
+                return length;
+            pos = newline - data + 1;
+            if (pos >= target)
+                return pos;
+        } else if (data[comment + 1] == '*') {
+            const char *close = find_comment_end(data + comment + 2, data + length);
+            pos = (close == data + length) ? length : close - data + 2;
+        } else {
+            pos = comment + 1;
+        }
     }
+
+    return length;
+}
+
+// Lex the rest of the input on a thread pool and append it to this->tokens
+// The tokens and errors are exactly the ones tokenize_input() produces.
+// The input is cut into chunks at the start of a line outside of any comment. No token
+// spans a newline, so every cut falls between two tokens. Each chunk is lexed by its own lexer as if it was the whole input, then the chunks
+// are stitched back together in order with their offsets shifted.
+// Inputs too small to split into chunks of at least min_chunk bytes are lexed sequentially,
+// and so are inputs with a '\0' in them, since the lexer stops at the first one, and inputs
+// with directives, since those have to be read in order.
+// A pool with a single thread has nothing to gain from chunks and lexes sequentially too.
+void
+Lexer::tokenize_input_parallel(ThreadPool &pool, size_t min_chunk) {
+    size_t begin = this->position;
+    size_t length = this->input.length();
+    size_t chunk_count = pool.size() > 1 ? pool.size() * 4 : 0;
+    if (min_chunk == 0)
+        min_chunk = 1;
+    if (begin >= length || chunk_count > (length - begin) / min_chunk)
+        chunk_count = begin >= length ? 0 : (length - begin) / min_chunk;
+    if (chunk_count >= 2 && memchr(this->input.data() + begin, '\0', length - begin) != nullptr)
+        chunk_count = 0;
+    if (chunk_count >= 2 && this->preprocessor != nullptr && memchr(this->input.data() + begin, '$', length - begin) != nullptr)
+        chunk_count = 0;
+    if (chunk_count < 2) {
+        this->tokenize_input();
+        return;
+    }
+
+    // cut the input at the first line start past every chunk_count'th of it
+    // the lexer is never inside a comment between tokens, so 'begin' is a safe place to start looking
+    std::vector <size_t> cuts = {begin};
+    size_t step = (length - begin) / chunk_count;
+    for (size_t i = 1; i < chunk_count; i++) {
+        size_t target = begin + i * step;
+        if (target < cuts.back())
+            continue;
+        size_t cut = next_line_outside_comment(this->input, cuts.back(), target);
+        if (cut >= length)
+            break;
+        if (cut > cuts.back())
+            cuts.push_back(cut);
+    }
+    cuts.push_back(length);
+    chunk_count = cuts.size() - 1;
+    TRACE(TRACE_LEXER, "lexing %zu bytes in %zu chunks", length - begin, chunk_count);
+
+    // lex every chunk on its own
+    std::vector <TokenBuffer> chunks(chunk_count);
+    std::vector <ErrorHandler> chunk_errors(chunk_count);
+    pool.run(chunk_count, [&](size_t i) {
+        Lexer lexer(this->input.substr(cuts[i], cuts[i+1] - cuts[i]));
+        lexer.error_handler = &chunk_errors[i];
+        bool last = (i == chunk_count - 1);
+
+        for (token_t tok = lexer.next_token(); ; tok = lexer.next_token()) {
+            if (tok.type == TOK_EOF) {
+                if (last)
+                    lexer.tokens.push(tok);
+                break;
+            }
+            lexer.tokens.push(tok);
+        }
+
+        chunks[i] = std::move(lexer.tokens);
+    });
+
+    // where every chunk starts in the output
+    std::vector <size_t> first_token(chunk_count + 1);
+    std::vector <size_t> first_value(chunk_count + 1);
+    first_token[0] = this->tokens.size();
+    first_value[0] = this->tokens.values.size();
+    for (size_t i = 0; i < chunk_count; i++) {
+        first_token[i+1] = first_token[i] + chunks[i].size();
+        first_value[i+1] = first_value[i] + chunks[i].values.size();
+    }
+
+    // stitch the chunks together -- every chunk copies itself into its own slice of the columns
+    TokenBuffer &out = this->tokens;
+    out.types.resize(first_token[chunk_count]);
+    out.offsets.resize(first_token[chunk_count]);
+    out.lengths.resize(first_token[chunk_count]);
+    out.payloads.resize(first_token[chunk_count]);
+    out.values.resize(first_value[chunk_count]);
+    pool.run(chunk_count, [&](size_t i) {
+        const TokenBuffer &chunk = chunks[i];
+        size_t t = first_token[i];
+        for (size_t j = 0; j < chunk.size(); j++, t++) {
+            out.types[t] = chunk.types[j];
+            out.offsets[t] = chunk.offsets[j] + this->base + (uint32_t)cuts[i];
+            out.lengths[t] = chunk.lengths[j];
+            out.payloads[t] = chunk.payloads[j];
+            if (chunk.types[j] == TOK_INT || chunk.types[j] == TOK_FLOAT)
+                out.payloads[t] += (uint32_t)first_value[i];
+        }
+        std::copy(chunk.values.begin(), chunk.values.end(), out.values.begin() + first_value[i]);
+    });
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        for (ErrorLogEntry &err : chunk_errors[i].error_log)
+            this->error_handler->new_error(err.offset + this->base + (uint32_t)cuts[i], err.message);
+    }
+
+    // leave the lexer just past the TOK_EOF, where tokenize_input() would have
+    this->seek(length + 1);
 }
 
 // get the next token
+// The first character picks the kind of token through the character class table.
+// Operators then take one step through the operator table: every two character
+// operator is a one character operator followed by '='
 token_t
 Lexer::next_token() {
     token_t tok;
 
+    // finish the alias being expanded first
+    if (this->expansion_position < this->expansion.size())
+        return this->expansion[this->expansion_position++];
+
+    // then the included files -- the $includes in them are followed when their turn comes
+    while (!this->includes.empty()) {
+        include_frame_t &frame = this->includes.back();
+        const included_file_t *file = frame.file;
+        if (frame.point < file->includes.size() && file->includes[frame.point].token == frame.token) {
+            const include_point_t &point = file->includes[frame.point++];
+            this->include_file(point.path, point.offset);
+            continue;
+        }
+        if (frame.token + 1 < file->tokens.size()) {
+            tok = file->tokens.get(frame.token++);
+            if (tok.type == TOK_IDENT && this->expand_alias(tok))
+                return this->next_token();
+            return tok;
+        }
+        this->includes.pop_back();
+    }
+
     this->skip_whitespace();
-    switch (this->cur_char) {
-        case '=':
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_EQUALTO;
-                tok.literal = "==";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_EQUALS;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
-            }
-            break;
-        case ';':
-            tok.type = TOK_SEMICOLON;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case '(':
-            tok.type = TOK_LPAREN;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case ')':
-            tok.type = TOK_RPAREN;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case '{':
-            tok.type = TOK_LBRACE;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case '}':
-            tok.type = TOK_RBRACE;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case '[':
-            tok.type = TOK_LBRACKET;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case ']':
-            tok.type = TOK_RBRACKET;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case ',':
-            tok.type = TOK_COMMA;
-            tok.literal = std::string(1, this->cur_char);
-            tok.line_num = this->line_num;
-            break;
-        case '+':
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_PLUS_EQUAL;
-                tok.literal = "+=";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_PLUS;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
-            }
-            break;
-        case '%':
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_MOD_EQUAL;
-                tok.literal = "%=";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_MOD;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
-            }
-            break;
-        case '<':
-            // future: account for '<<' for bitshifting
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_LTEQUALTO;
-                tok.literal = "<=";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_LT;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
-            }
-            break;
-        case '>':
-            // future: account for '>>' for bitshifting
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_GTEQUALTO;
-                tok.literal = ">=";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_GT;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
-            }
-            break;
-        case '!':
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_NOTEQUALTO;
-                tok.literal = "!=";
-                tok.line_num = this->line_num;
+    if (!this->includes.empty())
+        return this->next_token();
+    tok.offset = this->base + (uint32_t)this->position;
+
+    unsigned char c = (unsigned char)this->cur_char;
+    switch (char_classes[c]) {
+        case CHAR_OPERATOR:
+            if (operator_table[c].with_equals != TOK_ILLEGAL && this->peek_char() == '=') {
+                tok.type = operator_table[c].with_equals;
+                tok.literal = std::string_view(this->input.data() + this->position, 2);
+                this->seek(this->position + 2);
             } else {
-                tok.type = TOK_BANG;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
+                tok.type = operator_table[c].single;
+                tok.literal = std::string_view(this->input.data() + this->position, 1);
+                this->seek(this->position + 1);
             }
-            break;
-        case '*':
-            if (this->peek_char() == '=') {
-                // "*="
-                this->read_char();
-                tok.type = TOK_TIMES_EQUAL;
-                tok.literal = "*=";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_ASTERISK;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
+            return tok;
+        case CHAR_ALPHA:
+            tok.literal = this->read_identifier();
+            tok.type = this->lookup_identifier(tok.literal);
+            if (tok.type == TOK_IDENT) {
+                tok.value.symbol = this->symbols.intern(tok.literal);
+                if (this->expand_alias(tok))
+                    return this->next_token();
             }
-            break;
-        case '/':
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_DIV_EQUAL;
-                tok.literal = "/=";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_SLASH;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
+            return tok; // we return early here because read_identifier() advances this->cur_char repeatedly
+        case CHAR_DIGIT:
+            return this->read_number();
+        case CHAR_END:
+            if (this->preprocessor != nullptr) {
+                for (const condition_t &cond : this->preprocessor->conditions)
+                    this->error_handler->new_error(cond.offset, "lexer: $if without a matching $end");
+                this->preprocessor->conditions.clear();
             }
-            break;
-        case '-':
-            if (this->peek_char() == '=') {
-                this->read_char();
-                tok.type = TOK_MINUS_EQUAL;
-                tok.literal = "-=";
-                tok.line_num = this->line_num;
-            } else {
-                tok.type = TOK_MINUS;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
-            }
-            break;
-        case '\0':
             tok.type = TOK_EOF;
-            tok.literal = "";
-            tok.line_num = this->line_num;
+            tok.literal = this->input.substr(this->input.length(), 0);
             break;
         default:
-            if (isalpha(this->cur_char) != 0) {
-                tok.literal = this->read_identifier();
-                tok.type = this->lookup_identifier(tok.literal);
-                tok.line_num = this->line_num;
-                this->tokens.push_back(tok);
-                return tok; // we return early here because read_identifier() advances this->cur_char repeatedly
-            } else if (isdigit(this->cur_char) != 0) {
-                // for now assume all number are ints
-                // tok.type = TOK_INT;
-                tok = this->read_number();
-                tok.line_num = this->line_num;
-                this->tokens.push_back(tok);
-                return tok;
-            } else {
-                tok.type = TOK_ILLEGAL;
-                tok.literal = std::string(1, this->cur_char);
-                tok.line_num = this->line_num;
-                char err[50];
-                sprintf(err, "lexer: illegal token %s", tok.literal.c_str());
-                this->error_handler->new_error(tok.line_num, err);
-            }
-    };
+            tok.type = TOK_ILLEGAL;
+            tok.literal = this->input.substr(this->position, 1);
+            char err[50];
+            sprintf(err, "lexer: illegal token " SV_FMT, SV_ARG(tok.literal));
+            this->error_handler->new_error(tok.offset, err);
+            break;
+    }
 
     this->read_char();
-    this->tokens.push_back(tok);
     return tok;
 }
 
@@ -255,18 +417,22 @@ token_t
 Lexer::read_number() {
     token_t tok;
     int pos = this->position;
+    size_t end = pos;
+    size_t length = this->input.length();
     bool read_decimal = false;
     bool is_legal = true;
 
-    while (isdigit(this->cur_char) != 0 || this->cur_char == '.') {
-        if (this->cur_char == '.' && read_decimal == true) {
-            // 2 decimal points in one number
-            is_legal = false;
+    while (end < length && (char_classes[(unsigned char)this->input[end]] == CHAR_DIGIT || this->input[end] == '.')) {
+        if (this->input[end] == '.') {
+            if (read_decimal == true) {
+                // 2 decimal points in one number
+                is_legal = false;
+            }
+            read_decimal = true;
         }
-
-        if (this->cur_char == '.') read_decimal = true;
-        this->read_char();
+        end++;
     }
+    this->seek(end);
 
     if (is_legal == false) {
         tok.type = TOK_ILLEGAL;
@@ -276,46 +442,253 @@ Lexer::read_number() {
         tok.type = TOK_INT;
     }
 
-    tok.literal = this->input.substr(pos, this->position-pos);
+    tok.literal = std::string_view(this->input.data() + pos, end - pos);
+    tok.offset = this->base + (uint32_t)pos;
+    if (tok.type != TOK_ILLEGAL)
+        this->decode_number(tok);
 
     return tok;
 }
 
+// Decode the value of a TOK_INT or TOK_FLOAT token into tok.value
+// Literals that do not fit report an error and become the largest value there is
+void
+Lexer::decode_number(token_t &tok) {
+    const char *first = tok.literal.data();
+    const char *last = first + tok.literal.length();
+    std::from_chars_result result;
+
+    if (tok.type == TOK_INT) {
+        result = std::from_chars(first, last, tok.value.int_value);
+        if (result.ec == std::errc::result_out_of_range)
+            tok.value.int_value = INT64_MAX;
+    } else {
+        result = std::from_chars(first, last, tok.value.float_value);
+        if (result.ec == std::errc::result_out_of_range)
+            tok.value.float_value = HUGE_VAL;
+    }
+
+    if (result.ec == std::errc::result_out_of_range) {
+        char err[100];
+        sprintf(err, "lexer: %s literal %.*s%s is out of range",
+            tok.type == TOK_INT ? "int" : "float",
+            tok.literal.length() > 32 ? 32 : (int)tok.literal.length(), first,
+            tok.literal.length() > 32 ? "..." : "");
+        this->error_handler->new_error(tok.offset, err);
+    }
+}
+
 // Read an identifier string 
-std::string
+std::string_view
 Lexer::read_identifier() {
     int pos = this->position;
-    while (isalpha(this->cur_char) != 0 || this->cur_char == '_' || isdigit(this->cur_char) != 0) {
-        this->read_char();
-    }
+    const char *start = this->input.data() + pos;
+    size_t length = scan_identifier(start, this->input.data() + this->input.length());
 
-    return this->input.substr(pos, this->position-pos);
+    this->seek(pos + length);
+    return std::string_view(start, length);
 }
 
-// Lookup the identifier in the map of keywords to determine
+// Lookup the identifier in the keyword set to determine
 // if it is a keyword or normal identifier
 TokenType
-Lexer::lookup_identifier(std::string ident) {
-    if (this->keywords.find(ident) != this->keywords.end()) {
-        return this->keywords[ident];
+Lexer::lookup_identifier(std::string_view ident) {
+    return keyword_type(ident);
+}
+
+// eat whitespace, comments and directives until we read the start of a token
+// This is the preprocessor's old job done in the lexer's own pass over the source:
+// comments are skipped where they are found instead of being blanked out first
+void
+Lexer::skip_whitespace() {
+    const char *data = this->input.data();
+    size_t length = this->input.length();
+
+    while (true) {
+        unsigned char c = (unsigned char)this->cur_char;
+        if (char_classes[c] == CHAR_WHITESPACE) {
+            // most gaps between tokens are a single space, so only hand longer
+            // runs to the scanning kernel
+            // lines are not counted here -- the LineTable works them out from offsets when needed
+            size_t pos = this->position + 1;
+            if (pos < length && char_classes[(unsigned char)data[pos]] == CHAR_WHITESPACE)
+                pos += scan_whitespace(data + pos, data + length, nullptr);
+            this->seek(pos);
+        } else if (c == '/' && this->peek_char() == '/') {
+            // single line comment -- stop on the '\n'
+            const char *newline = (const char*)memchr(data + this->position, '\n', length - this->position);
+            this->seek(newline == nullptr ? length : newline - data);
+        } else if (c == '/' && this->peek_char() == '*') {
+            // multi-line comment -- an unterminated one runs to the end of the input
+            const char *close = find_comment_end(data + this->position + 2, data + length);
+            this->seek(close == data + length ? length : close - data + 2);
+        } else if (c == '$' && this->preprocessor != nullptr) {
+            this->read_directive();
+        } else {
+            return;
+        }
     }
+}
+
+// Hand the directive at the current position to the preprocessor and move past it
+void
+Lexer::read_directive() {
+    size_t end = this->position;
+    directive_e directive = this->preprocessor->read_directive(this->input, end);
 
-    return TOK_IDENT;
+    if (directive == DIR_INVALID) {
+        std::string_view name = this->input.substr(this->position, end - this->position);
+        char err[100];
+        sprintf(err, "lexer: unknown directive %.*s", name.length() > 32 ? 32 : (int)name.length(), name.data());
+        this->error_handler->new_error(this->base + (uint32_t)this->position, err);
+    }
+
+    uint32_t offset = this->base + (uint32_t)this->position;
+    this->seek(end);
+    if (directive == DIR_ALIAS)
+        this->read_alias();
+    else if (directive == DIR_INCLUDE)
+        this->read_include(offset);
+    else if (directive != DIR_INVALID)
+        this->read_condition(directive, offset);
 }
 
-// eat whitespace until we read a non-whitespace character
+// Read "name replacement" after an $alias, up to the end of the line
+// The line is lexed by a lexer that stops at the newline, so the replacement
+// is stored as tokens and never has to be scanned again
 void
-Lexer::skip_whitespace() {
-    while (
-        this->cur_char == ' ' ||
-        this->cur_char == '\n' ||
-        this->cur_char == '\t' ||
-        this->cur_char == '\r'
-    ) {
-        if (this->cur_char == '\n')
-            this->line_num++;
-        this->read_char();
+Lexer::read_alias() {
+    const char *newline = (const char*)memchr(this->input.data() + this->position, '\n', this->input.length() - this->position);
+    size_t line_end = (newline == nullptr) ? this->input.length() : newline - this->input.data();
+
+    Lexer line(this->input.substr(0, line_end), this->base);
+    line.error_handler = this->error_handler;
+    line.seek(this->position);
+
+    token_t name = line.next_token();
+    if (name.type != TOK_IDENT) {
+        char err[100];
+        sprintf(err, "lexer: $alias needs a name. Got '%.*s'", name.literal.length() > 32 ? 32 : (int)name.literal.length(), name.literal.data());
+        this->error_handler->new_error(name.offset, err);
+    } else {
+        std::vector <token_t> replacement;
+        for (token_t tok = line.next_token(); tok.type != TOK_EOF; tok = line.next_token())
+            replacement.push_back(tok);
+        this->preprocessor->define_alias(name.value.symbol, std::move(replacement));
+    }
+
+    this->seek(line_end);
+}
+
+// Read a $define, $if, $else or $end
+// A disabled region is jumped over in one go -- none of it is tokenized
+void
+Lexer::read_condition(directive_e directive, uint32_t offset) {
+    size_t pos = this->position;
+
+    if (directive == DIR_DEFINE || directive == DIR_IF) {
+        std::string_view name = this->preprocessor->read_name(this->input, pos);
+        if (name.empty()) {
+            this->error_handler->new_error(offset, directive == DIR_IF ? "lexer: $if needs a name" : "lexer: $define needs a name");
+        } else if (directive == DIR_DEFINE) {
+            this->preprocessor->define(name);
+        } else if (!this->preprocessor->open_condition(name, offset)) {
+            pos = this->preprocessor->skip_disabled(this->input, pos);
+        }
+    } else if (directive == DIR_ELSE) {
+        else_result_e result = this->preprocessor->flip_condition();
+        if (result == ELSE_UNMATCHED)
+            this->error_handler->new_error(offset, "lexer: $else without a matching $if");
+        else if (result == ELSE_DISABLED)
+            pos = this->preprocessor->skip_disabled(this->input, pos);
+    } else if (directive == DIR_END) {
+        if (!this->preprocessor->close_condition())
+            this->error_handler->new_error(offset, "lexer: $end without a matching $if");
+    }
+
+    this->seek(pos);
+}
+
+// Read the "file" after an $include
+// The name is resolved against the directory of the source. Lexing for the include
+// cache only records where the $include was, otherwise the file's tokens come next.
+void
+Lexer::read_include(uint32_t offset) {
+    const char *data = this->input.data();
+    size_t length = this->input.length();
+
+    size_t pos = this->position;
+    while (pos < length && (data[pos] == ' ' || data[pos] == '\t'))
+        pos++;
+    const char *newline = (const char*)memchr(data + pos, '\n', length - pos);
+    size_t line_end = (newline == nullptr) ? length : newline - data;
+    const char *close = (pos < line_end && data[pos] == '"') ? (const char*)memchr(data + pos + 1, '"', line_end - pos - 1) : nullptr;
+    if (close == nullptr) {
+        this->error_handler->new_error(offset, "lexer: $include needs a file name in double quotes");
+        this->seek(line_end);
+        return;
     }
+
+    std::string path = this->preprocessor->include_path(std::string_view(data + pos + 1, close - data - pos - 1));
+    this->seek(close - data + 1);
+
+    if (this->include_points != nullptr)
+        this->include_points->push_back(include_point_t{this->tokens.size(), offset, std::move(path)});
+    else
+        this->include_file(path, offset);
+}
+
+// Hand out the tokens of a file before anything else
+// Each file is only included once, any later $include of it is skipped. The tokens
+// come from the include cache, so a file included by many sources is only lexed once.
+void
+Lexer::include_file(const std::string &path, uint32_t offset) {
+    // skip files already included before they are loaded, which could mean lexing them
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) != nullptr && this->preprocessor->included.count(resolved) != 0) {
+        TRACE(TRACE_LEXER, "include %.80s: already included", path.c_str());
+        return;
+    }
+
+    std::string reason;
+    const included_file_t *file = include_cache.load(path, &reason);
+    if (file == nullptr) {
+        char err[100];
+        sprintf(err, "lexer: cannot include %.*s: %.40s", path.length() > 40 ? 40 : (int)path.length(), path.c_str(), reason.c_str());
+        this->error_handler->new_error(offset, err);
+        return;
+    }
+
+    if (!this->preprocessor->included.insert(file->path).second)
+        return;
+
+    TRACE(TRACE_LEXER, "include %.80s: %zu tokens", file->path.c_str(), file->tokens.size());
+    for (const ErrorLogEntry &err : file->errors)
+        this->error_handler->new_error(err.offset, err.message);
+    this->includes.push_back(include_frame_t{file, 0, 0});
+}
+
+// Queue up the expansion of an identifier if it is an alias
+bool
+Lexer::expand_alias(const token_t &tok) {
+    if (this->preprocessor == nullptr || this->preprocessor->aliases.empty())
+        return false;
+
+    const std::vector <token_t> *alias = this->preprocessor->expand_alias(tok.value.symbol);
+    if (alias == nullptr)
+        return false;
+
+    this->expansion.assign(alias->begin(), alias->end());
+    this->expansion_position = 0;
+    return true;
+}
+
+// move the lexer to a position in the input
+// same as calling read_char() until we get there
+void
+Lexer::seek(size_t pos) {
+    this->read_position = pos;
+    this->read_char();
 }
 
 // read character from the input in the lexer
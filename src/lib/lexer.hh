@@ -4,36 +4,65 @@
 
 #include <iostream>
 #include <string>
-#include <map>
+#include <string_view>
 #include <vector>
 
 #include "token.hh"
+#include "tokenbuffer.hh"
+#include "interner.hh"
 #include "symboltable.hh"
 #include "errorhandler.hh"
+#include "threadpool.hh"
+#include "preprocessor.hh"
+#include "includecache.hh"
+
+// Smallest chunk of input the parallel lexer hands to a thread
+#define LEXER_MIN_CHUNK (1 << 20)
+
+// An included file whose tokens the lexer is handing out
+typedef struct IncludeFrame {
+    const included_file_t *file;
+    size_t token;       // next token of the file to hand out
+    size_t point;       // next of the file's $includes to follow
+} include_frame_t;
 
 class Lexer {
     private:
 
     public:
-        std::string input; // the source code input
-        int line_num;            // the line number that we are currently on
+        std::string_view input; // the source code input -- view of the buffer owned by the compiler
+        uint32_t base;           // offset of input[0] -- 0 unless the input is an included file
         int position;            // the current position in the input
         int read_position; // the current reading position in input (after current char)
         char cur_char;         // current char under examination
-        std::map<std::string, TokenType> keywords;
-        std::vector <token_t> tokens;
+        TokenBuffer tokens;      // token stream filled in by tokenize_input()
+        SymbolCache symbols;     // recently interned identifiers
         ErrorHandler *error_handler; // a pointer to the -compilers's- error handler -- THIS IS OWNED BY THE COMPILER DO NOT FREE
+        Preprocessor *preprocessor;  // handles the '$' directives -- nullptr makes them illegal tokens. DO NOT FREE
+        std::vector <token_t> expansion; // tokens of the alias being expanded
+        size_t expansion_position;       // next token to hand out from 'expansion'
+        std::vector <include_frame_t> includes;        // the included files being handed out, innermost last
+        std::vector <include_point_t> *include_points; // if set $includes are recorded here instead of followed. DO NOT FREE
 
-        Lexer(std::string input);
+        Lexer(std::string_view input, uint32_t base = 0);
         Lexer(Lexer &l);
         token_t next_token();
         void read_char();
-        std::string read_identifier();
+        void seek(size_t pos);
+        std::string_view read_identifier();
         token_t read_number();
+        void decode_number(token_t &tok);
         char peek_char();
-        TokenType lookup_identifier(std::string ident);
-        void skip_whitespace();
+        TokenType lookup_identifier(std::string_view ident);
+        void skip_whitespace();  // skips comments and directives too
+        void read_directive();
+        void read_alias();       // read the definition of an alias
+        void read_include(uint32_t offset); // read the file name of the $include at offset
+        void read_condition(directive_e directive, uint32_t offset); // read a $define, $if, $else or $end
+        void include_file(const std::string &path, uint32_t offset); // hand out the tokens of a file next
+        bool expand_alias(const token_t &tok); // hand out the expansion next if tok is an alias
         void tokenize_input(); // iterate through the entire input and create a token stream
+        void tokenize_input_parallel(ThreadPool &pool, size_t min_chunk = LEXER_MIN_CHUNK); // same as tokenize_input() but split over a thread pool
 };
 
 #endif /* LEXER_ */
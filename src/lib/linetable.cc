@@ -0,0 +1,36 @@
+#include "linetable.hh"
+
+#include <algorithm>
+#include <cstring>
+
+// Find the line and column of a byte offset in the source
+// Offsets past the end of the source land on the last line
+source_location_t
+LineTable::locate(uint32_t offset) {
+    if (this->line_starts.empty())
+        this->build();
+
+    // the last line starting at or before the offset
+    auto it = std::upper_bound(this->line_starts.begin(), this->line_starts.end(), offset);
+    size_t line = it - this->line_starts.begin();
+
+    source_location_t loc;
+    loc.line = line;
+    loc.column = offset - this->line_starts[line - 1] + 1;
+    return loc;
+}
+
+// Record where every line of the source starts
+void
+LineTable::build() {
+    const char *start = this->source.data();
+    const char *end = start + this->source.length();
+
+    this->line_starts.push_back(0);
+    for (const char *p = start; p < end; p++) {
+        p = (const char*)memchr(p, '\n', end - p);
+        if (p == nullptr)
+            break;
+        this->line_starts.push_back((uint32_t)(p + 1 - start));
+    }
+}
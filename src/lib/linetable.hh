@@ -0,0 +1,43 @@
+/*
+ *    linetable.hh
+ *
+ *    This file contains the index that turns byte offsets in a
+ *    source file into line and column numbers
+ *
+ */
+
+#pragma once
+#ifndef LINE_TABLE_
+#define LINE_TABLE_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// A line and column in a source file -- both start at 1
+typedef struct SourceLocation {
+    size_t line;
+    size_t column;      // in bytes from the start of the line
+} source_location_t;
+
+// Line table
+// Tokens and errors only store the byte offset they start at. The table of where every line
+// starts is built the first time a location is asked for -- usually when a diagnostic is
+// printed -- and each lookup after that is a binary search over it.
+class LineTable {
+    public:
+        std::string_view source;                // the source code the offsets point into
+        std::vector <uint32_t> line_starts;     // offset of the first character of every line -- empty until first use
+
+        LineTable() {}
+        LineTable(std::string_view source) : source(source) {}
+
+        source_location_t locate(uint32_t offset);
+        size_t line(uint32_t offset) { return this->locate(offset).line; }
+
+    private:
+        void build();
+};
+
+#endif /* LINE_TABLE_ */
@@ -0,0 +1,85 @@
+#include "parsecache.hh"
+#include "interner.hh"
+
+// Mix one more word into a fingerprint
+static inline uint64_t
+mix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+// Fingerprint of the tokens in [begin, end) of a token buffer
+// Identifiers are their symbols and numbers their spelling. Every other token is spelled
+// the same way every time, so its type is enough.
+uint64_t
+fingerprint_tokens(const TokenBuffer &tokens, size_t begin, size_t end, uint64_t seed) {
+    uint64_t hash = mix(seed, end - begin);
+    for (size_t i = begin; i < end; i++) {
+        TokenType type = tokens.type(i);
+        hash = mix(hash, type);
+        if (type == TOK_IDENT)
+            hash = mix(hash, tokens.payloads[i]);
+        else if (type == TOK_INT || type == TOK_FLOAT || type == TOK_ILLEGAL)
+            hash = mix(hash, hash_name(tokens.literal(i)));
+    }
+
+    return hash;
+}
+
+// Constructor -- the cache starts out empty
+ParseCache::ParseCache() {
+    this->globals = 0;
+    this->reused = 0;
+    this->parsed = 0;
+}
+
+// Destructor -- free the arenas and sources of the parses kept alive
+ParseCache::~ParseCache() {
+    this->clear();
+}
+
+// Remove a remembered function and return it
+// Each function can only be spliced into a program once
+FunctionDecl*
+ParseCache::take(uint64_t fingerprint) {
+    auto it = this->functions.find(fingerprint);
+    if (it == this->functions.end())
+        return nullptr;
+
+    FunctionDecl *function = it->second;
+    this->functions.erase(it);
+    return function;
+}
+
+// Take over the arena and source of the parse that just finished
+// If that parse spliced nothing in, nothing points into the older parses any more and
+// they are freed
+void
+ParseCache::keep(Arena *arena, SourceBuffer *source) {
+    if (this->reused == 0) {
+        for (Arena *old : this->arenas)
+            delete old;
+        for (SourceBuffer *old : this->sources)
+            delete old;
+        this->arenas.clear();
+        this->sources.clear();
+    }
+
+    this->arenas.push_back(arena);
+    this->sources.push_back(source);
+}
+
+// Forget every function and free everything the cache owns
+void
+ParseCache::clear() {
+    this->functions.clear();
+    for (Arena *arena : this->arenas)
+        delete arena;
+    for (SourceBuffer *source : this->sources)
+        delete source;
+    this->arenas.clear();
+    this->sources.clear();
+    this->globals = 0;
+    this->reused = 0;
+    this->parsed = 0;
+}
@@ -0,0 +1,60 @@
+/*
+ *    parsecache.hh
+ *
+ *    This file contains the cache that lets a source be parsed again
+ *    after an edit without parsing the functions that did not change
+ *
+ */
+
+#pragma once
+#ifndef PARSE_CACHE_
+#define PARSE_CACHE_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.hh"
+#include "ast.hh"
+#include "sourcebuffer.hh"
+#include "tokenbuffer.hh"
+
+// Number of parses the cache keeps alive before the next parse starts over
+#define PARSE_CACHE_GENERATIONS 8
+
+// Fingerprint of the tokens in [begin, end) of a token buffer
+// Only the types and spellings of the tokens go into it, not their offsets, so a function
+// keeps its fingerprint when an edit above it moves it around the file
+uint64_t fingerprint_tokens(const TokenBuffer &tokens, size_t begin, size_t end, uint64_t seed = 0);
+
+// Parse cache
+// Remembers the top-level functions of the last parse of a source by the fingerprint of
+// their tokens. The next parse of the source splices every function whose tokens did not
+// change back into its program -- body, CodeBlock symbol tables and all -- and only parses
+// the ones that did. A function is only remembered if it parsed without errors and ended
+// at its closing '}', since then it parses the same wherever it is in the file.
+// Spliced functions still live in the arena of the parse that made them and their tokens
+// slice the source that parse read, so the cache owns both for every parse it keeps.
+// Once it holds PARSE_CACHE_GENERATIONS of them, the next parse starts over from nothing
+// and frees the old ones, so what edits leave behind does not pile up.
+class ParseCache {
+    public:
+        std::unordered_multimap <uint64_t, FunctionDecl*> functions; // remembered functions by fingerprint
+        uint64_t globals;                       // fingerprint of the tokens outside of function bodies
+        std::vector <Arena*> arenas;            // arenas of the parses kept alive
+        std::vector <SourceBuffer*> sources;    // sources of the parses kept alive
+        size_t reused;                          // functions the last parse spliced in
+        size_t parsed;                          // functions the last parse had to parse
+
+        ParseCache();
+        ~ParseCache();
+        ParseCache(const ParseCache&) = delete;
+        ParseCache& operator=(const ParseCache&) = delete;
+
+        bool full() const { return this->arenas.size() >= PARSE_CACHE_GENERATIONS; }
+        FunctionDecl *take(uint64_t fingerprint);       // remove a remembered function -- nullptr if there is none
+        void keep(Arena *arena, SourceBuffer *source);  // take over the arena and source of the parse that just finished
+        void clear();                                   // forget everything and free what the cache owns
+};
+
+#endif /* PARSE_CACHE_ */
@@ -4,48 +4,156 @@
 #include "lexer.hh"
 #include "errorhandler.hh"
 #include "symboltable.hh"
+#include "trace.hh"
 
+#include <algorithm>
 #include <string>
 #include <cstdlib>
-#include <memory>
+#include <cstring>
+#include <initializer_list>
 #include <type_traits>
+#include <vector>
+
+// Number of token types -- TOK_ENTRY is the last one
+#define TOKEN_TYPE_COUNT (TOK_ENTRY + 1)
+
+// How an infix operator groups with another of the same binding power
+typedef enum Associativity {
+    ASSOC_LEFT,     // "a - b - c" is "(a - b) - c"
+    ASSOC_RIGHT,    // "a = b = c" is "a = (b = c)"
+} associativity_e;
+
+// What the expression parser does with a token
+// prefix parses an expression starting with the token, infix continues the expression on
+// its left with the token. power is how tightly an infix operator binds -- 0 if it is not one.
+typedef struct ParseRule {
+    expr_t (Parser::*prefix)();
+    expr_t (Parser::*infix)(expr_t LHS);
+    int power;
+    associativity_e assoc;
+} parse_rule_t;
+
+typedef struct ParseRuleTable {
+    parse_rule_t entries[TOKEN_TYPE_COUNT];
+    constexpr const parse_rule_t &operator[](TokenType type) const { return this->entries[type]; }
+} parse_rule_table_t;
+
+// Build the rule of every token type at compile time
+static constexpr parse_rule_table_t
+make_parse_rules() {
+    parse_rule_table_t table = {};
+    for (int i = 0; i < TOKEN_TYPE_COUNT; i++)
+        table.entries[i] = parse_rule_t{nullptr, nullptr, 0, ASSOC_LEFT};
+
+    table.entries[TOK_INT].prefix = &Parser::_parse_integer;
+    table.entries[TOK_BYTE].prefix = &Parser::_parse_byte;
+    table.entries[TOK_FLOAT].prefix = &Parser::_parse_float;
+    table.entries[TOK_TRUE].prefix = &Parser::_parse_boolean;
+    table.entries[TOK_FALSE].prefix = &Parser::_parse_boolean;
+    table.entries[TOK_IDENT].prefix = &Parser::_parse_identifier;
+    table.entries[TOK_LPAREN].prefix = &Parser::_parse_parentheses_expr;
+
+    struct { TokenType type; int power; associativity_e assoc; } infix[] = {
+        {TOK_EQUALS, 1, ASSOC_RIGHT},
+        {TOK_EQUALTO, 2, ASSOC_LEFT},
+        {TOK_NOTEQUALTO, 2, ASSOC_LEFT},
+        {TOK_PLUS_EQUAL, 2, ASSOC_RIGHT},
+        {TOK_MINUS_EQUAL, 2, ASSOC_RIGHT},
+        {TOK_TIMES_EQUAL, 2, ASSOC_RIGHT},
+        {TOK_DIV_EQUAL, 2, ASSOC_RIGHT},
+        {TOK_MOD_EQUAL, 2, ASSOC_RIGHT},
+        {TOK_LT, 3, ASSOC_LEFT},
+        {TOK_GT, 3, ASSOC_LEFT},
+        {TOK_LTEQUALTO, 3, ASSOC_LEFT},
+        {TOK_GTEQUALTO, 3, ASSOC_LEFT},
+        {TOK_PLUS, 4, ASSOC_LEFT},
+        {TOK_MINUS, 4, ASSOC_LEFT},
+        {TOK_ASTERISK, 5, ASSOC_LEFT},
+        {TOK_MOD, 5, ASSOC_LEFT},
+        {TOK_SLASH, 5, ASSOC_LEFT},
+        {TOK_BANG, 6, ASSOC_LEFT}, // future: a prefix operator, potentialy with bitwise not '~' of the SAME precedence
+    };
+    for (auto &op : infix) {
+        table.entries[op.type].infix = &Parser::_parse_infix_op;
+        table.entries[op.type].power = op.power;
+        table.entries[op.type].assoc = op.assoc;
+    }
 
-// Constructor
-Parser::Parser(std::vector<token_t> token_stream) {
-    this->token_stream = token_stream;
-    this->current_position = 0;
-    this->has_entry = false;
+    return table;
+}
 
-    // Initialize the token values
-    this->current_token.type = TOK_ILLEGAL;
-    this->current_token.literal = "";
-
-    this->peek_token.type = TOK_ILLEGAL;
-    this->peek_token.literal = "";
-
-    // Set operator precedences
-    this->operator_precedences[TOK_EQUALS] = 1;
-    this->operator_precedences[TOK_EQUALTO] = 2;
-    this->operator_precedences[TOK_PLUS_EQUAL] = 2;
-    this->operator_precedences[TOK_MINUS_EQUAL] = 2;
-    this->operator_precedences[TOK_TIMES_EQUAL] = 2;
-    this->operator_precedences[TOK_DIV_EQUAL] = 2;
-    this->operator_precedences[TOK_MOD_EQUAL] = 2;
-    this->operator_precedences[TOK_LT] = 3;
-    this->operator_precedences[TOK_GT] = 3;
-    this->operator_precedences[TOK_LTEQUALTO] = 3;
-    this->operator_precedences[TOK_GTEQUALTO] = 3;
-    this->operator_precedences[TOK_PLUS] = 4;
-    this->operator_precedences[TOK_MINUS] = 4;
-    this->operator_precedences[TOK_ASTERISK] = 5;
-    this->operator_precedences[TOK_MOD] = 5;
-    this->operator_precedences[TOK_SLASH] = 5;
-    this->operator_precedences[TOK_BANG] = 6; // future: potentialy as bitwise not '~' prefix operator of SAME precedence as the bang operator
-
-
-    // fill in the first two tokens
-    this->_next_token();
-    this->_next_token();
+static constexpr parse_rule_table_t parse_rules = make_parse_rules();
+
+static_assert(parse_rules[TOK_ASTERISK].power > parse_rules[TOK_PLUS].power, "parse rule table out of sync");
+static_assert(parse_rules[TOK_SEMICOLON].infix == nullptr, "parse rule table out of sync");
+
+// Build a set of token types
+static constexpr token_set_t
+token_set(std::initializer_list <TokenType> types) {
+    token_set_t set = 0;
+    for (TokenType type : types)
+        set |= (token_set_t)1 << type;
+    return set;
+}
+
+static_assert(TOKEN_TYPE_COUNT <= 64, "token types do not fit in a token_set_t");
+
+// Synchronization sets of the panic mode error recovery
+// After a syntax error a production skips ahead to a token in its set -- one that it or
+// the production it is part of knows how to go on from. TOK_EOF is in every set, so the
+// skipping always stops.
+// where any production gives up -- the next function or the end of the input
+static constexpr token_set_t SYNC_FUNCTION = token_set({TOK_FUNCTION, TOK_ENTRY, TOK_EOF});
+// statements -- the end of the statement or of its block, or the start of the next one
+static constexpr token_set_t SYNC_STATEMENT = SYNC_FUNCTION | token_set({TOK_SEMICOLON, TOK_RBRACE, TOK_LET, TOK_IF, TOK_WHILE, TOK_FOR, TOK_RETURN});
+// expressions -- also the end of the argument list or condition they are in
+static constexpr token_set_t SYNC_EXPRESSION = SYNC_STATEMENT | token_set({TOK_COMMA, TOK_RPAREN, TOK_LBRACE});
+// function call arguments -- the end of the call
+static constexpr token_set_t SYNC_ARGUMENT = SYNC_STATEMENT | token_set({TOK_RPAREN});
+// function parameters -- the next parameter, or the end of the list or of the prototype
+static constexpr token_set_t SYNC_PARAMETER = SYNC_FUNCTION | token_set({TOK_COMMA, TOK_RPAREN, TOK_LBRACE});
+
+// Expression node of a kind, with no name or operands yet
+static inline expr_node_t
+expr_node(NodeKind kind, DataType data_type) {
+    expr_node_t node;
+    memset(&node, 0, sizeof(node));
+    node.kind = kind;
+    node.op = TOK_ILLEGAL;
+    node.data_type = data_type;
+    node.name = SYMBOL_NONE;
+    node.children[0] = EXPR_NONE;
+    node.children[1] = EXPR_NONE;
+    return node;
+}
+
+// Constructor -- pulls tokens from the lexer as they are needed
+Parser::Parser(Lexer *lexer) : token_stream(lexer) {
+    this->_init();
+}
+
+// Constructor -- reads tokens from an already filled token buffer
+Parser::Parser(const TokenBuffer &token_buffer) : token_stream(token_buffer) {
+    this->_init();
+}
+
+// Constructor -- reads the tokens in [begin, end) of an already filled token buffer
+// The parser sees a TOK_EOF at 'end'
+Parser::Parser(const TokenBuffer &token_buffer, size_t begin, size_t end) : token_stream(token_buffer, begin, end) {
+    this->_init();
+}
+
+// Set up the state shared by the constructors
+void
+Parser::_init() {
+    this->has_entry = false;
+    this->arena = nullptr;
+    this->pool = nullptr;
+    this->cache = nullptr;
+    this->next_parsed_function = 0;
+    this->tokens_eaten = 0;
+    this->depth = 0;
+    this->exprs = &this->global_exprs;
 }
 
 // Destructor -- delete the lexical analyzer
@@ -55,25 +163,80 @@ Parser::~Parser() {
 // Advance the current token to the next one
 void
 Parser::_next_token() {
-    printf("_next_token: eating '%s'\n", this->current_token.literal.c_str());
-    this->current_token = this->peek_token;
- 
-    if (this->current_position < this->token_stream.size())
-        this->peek_token = this->token_stream[this->current_position];
+    TRACE(TRACE_PARSER, "_next_token: eating '" SV_FMT "'\n", SV_ARG(this->_current().literal));
+    this->token_stream.advance();
+    this->tokens_eaten++;
+}
 
-    this->current_position++;
+// Index in the token buffer of the current token
+size_t
+Parser::_token_index() {
+    return this->token_stream.position();
+}
+
+// Make the token at a buffer index the current token
+void
+Parser::_seek(size_t position) {
+    this->token_stream.seek(position);
+}
+
+// Skip tokens until the current one is in 'sync'
+// Panic mode error recovery: once a production has reported an error it throws away what
+// it cannot parse, up to a token it can go on from. The start of the next function and
+// the end of the input stop every skip, so this always ends.
+void
+Parser::_synchronize(token_set_t sync) {
+    while (!this->_at(sync | SYNC_FUNCTION)) {
+        TRACE(TRACE_PARSER, "synchronize: eating invalid token '" SV_FMT "'\n", SV_ARG(this->_current().literal));
+        this->_next_token();
+    }
+}
+
+// Skip the rest of a statement that could not be parsed, up to and including its ';'
+void
+Parser::_skip_statement() {
+    this->_synchronize(SYNC_STATEMENT);
+    if (this->_current().type == TOK_SEMICOLON)
+        this->_next_token();
+}
+
+// Start a new expression table in the arena and add the expressions parsed from here on
+// to it, until _finish_exprs
+void
+Parser::_begin_exprs(expr_builder_t *builder) {
+    builder->table = this->arena->make<ExprTable>();
+    builder->nodes.clear();
+    builder->args.clear();
+    this->exprs = builder;
+}
+
+// Copy the expressions added since _begin_exprs into their table
+void
+Parser::_finish_exprs() {
+    this->exprs->table->nodes = this->arena->list(this->exprs->nodes);
+    this->exprs->table->args = this->arena->list(this->exprs->args);
+}
+
+// Get the interned name of a token
+// Identifiers were interned by the lexer. Any other token only ends up as a name
+// during error recovery, so interning its literal here is not worth avoiding
+symbol_t
+Parser::_symbol(const token_t &tok) {
+    if (tok.type == TOK_IDENT)
+        return tok.value.symbol;
+    return intern(tok.literal);
 }
 
 // Parse let statements
 // This statement is where variables are declared and initialized
 // Variables are required to be initialized to a specific value
 // "let int x = 5;"
-std::shared_ptr<Statement>
+Statement*
 Parser::_parse_let_statement() {
-    token_t let_tok = this->current_token;
-    printf("parse_let: should be eating 'let'\n");
+    token_t let_tok = this->_current();
+    TRACE(TRACE_PARSER, "parse_let: should be eating 'let'\n");
     this->_next_token(); // eat the TOK_LET token
-    token_t type_spec = this->current_token;
+    token_t type_spec = this->_current();
     DataType data_type;
     
     // Ensure valid type spec
@@ -94,113 +257,154 @@ Parser::_parse_let_statement() {
             data_type = TYPE_VOID;
             break;
         default:
-            printf("error: invalid type specifier |%s|\n", type_spec.literal.c_str());
+            char err[100];
+            snprintf(err, sizeof(err), "invalid type specifier |" SV_FMT "|", SV_ARG(type_spec.literal));
+            this->error_handler->new_error(type_spec.offset, err);
+            this->_skip_statement();
             return nullptr;
     }
 
     // Parse the identifier
     token_t ident_tok;
     if (data_type != TYPE_VOID) { /// NO ERROR ///
-        printf("parse_let: should be eating type specifier\n");
+        TRACE(TRACE_PARSER, "parse_let: should be eating type specifier\n");
         this->_next_token(); // eat the type specifier
 
-        if (this->current_token.type != TOK_IDENT) {
-            if (this->current_token.type == TOK_EQUALS) {
+        if (this->_current().type != TOK_IDENT) {
+            if (this->_current().type == TOK_EQUALS) {
                 // Missing identifier name, create temp one for 
                 // error recovery
-                char err[100];
-                sprintf(err, "Missing identifier name\n");
-                this->error_handler->new_error(this->current_token.line_num, err);
+                this->error_handler->new_error(this->_current().offset, "missing identifier name");
 
                 ident_tok.type = TOK_IDENT;
                 ident_tok.literal = "INVALID_IDENT::MISSING";
-                ident_tok.line_num = this->current_token.line_num;
+                ident_tok.offset = this->_current().offset;
             } else {
-                // Error Recovery: eat tokens until we get an identifier
-                while (this->current_token.type != TOK_IDENT) {
-                    printf("parse_let: eating invalid token\n");
+                // Error Recovery: look ahead for the identifier -- "let int 5 x = 3;"
+                // Only an identifier followed by '=' or ';' is taken, and the search stops at the
+                // end of the statement, so a let without a name does not eat what comes after it
+                char err[100];
+                snprintf(err, sizeof(err), "unexpected token |" SV_FMT "|. Expected |TOK_IDENT|", SV_ARG(this->_current().literal));
+                this->error_handler->new_error(this->_current().offset, err);
+
+                size_t skip = 0;
+                for (size_t k = 1; k + 1 < TOKEN_LOOKAHEAD; k++) {
+                    TokenType type = this->_peek(k).type;
+                    if (type == TOK_SEMICOLON || type == TOK_EQUALS || type == TOK_RBRACE || type == TOK_EOF)
+                        break;
+                    TokenType after = this->_peek(k + 1).type;
+                    if (type == TOK_IDENT && (after == TOK_EQUALS || after == TOK_SEMICOLON)) {
+                        skip = k;
+                        break;
+                    }
+                }
+
+                if (skip == 0) {
+                    // No name anywhere -- drop the statement
+                    this->_skip_statement();
+                    return nullptr;
+                }
+
+                for (; skip > 0; skip--) {
+                    TRACE(TRACE_PARSER, "parse_let: eating invalid token\n");
                     this->_next_token();
                 }
-                ident_tok = this->current_token;
-                printf("parse_let: should be eating identifier\n");
+                ident_tok = this->_current();
+                TRACE(TRACE_PARSER, "parse_let: should be eating identifier\n");
                 this->_next_token(); // eat the identifier
             }
         } else {
-            ident_tok = this->current_token; // grab the identifier
-            printf("parse_let: should be eating identifier\n");
+            ident_tok = this->_current(); // grab the identifier
+            TRACE(TRACE_PARSER, "parse_let: should be eating identifier\n");
             this->_next_token(); // eat the identifier
         }
     } else { /// ERRORS ///
         // We got invalid data type, either mispelled type spec or forgotten type spec
-        if (this->peek_token.type == TOK_EQUALS) {
+        if (this->_peek(1).type == TOK_EQUALS || this->_peek(1).type == TOK_SEMICOLON) {
             /*
-                 read identifier then an equals -> assume they forgot to put type spec
+                 read identifier then an equals or ';' -> assume they forgot to put type spec
                  because they forgot it, we have one less token, and we are already at the variable identifier
             */
-            char msg[100];
-            sprintf(msg, "parse_let: error on line %d: missing type specifier for '%s'\n", type_spec.line_num, type_spec.literal.c_str());
-            std::string errmsg = msg;
-            this->error_handler->new_error(type_spec.line_num, errmsg);
+            char err[100];
+            snprintf(err, sizeof(err), "missing type specifier for '" SV_FMT "'", SV_ARG(type_spec.literal));
+            this->error_handler->new_error(type_spec.offset, err);
             ident_tok = type_spec;
 
-        } else if (this->peek_token.type == TOK_IDENT) {
+        } else if (this->_peek(1).type == TOK_IDENT) {
             /* 
                  read identifier then another identifier, assume they mispelled type spec
                  we should still have correct number of tokens, so we can continue
                  keep the data type as VOID for now
             */
-            printf("parse_let: error on line %d: misspelled type specifier '%s'\n", type_spec.line_num, type_spec.literal.c_str());
+            char err[100];
+            snprintf(err, sizeof(err), "misspelled type specifier '" SV_FMT "'", SV_ARG(type_spec.literal));
+            this->error_handler->new_error(type_spec.offset, err);
 
-            printf("parse_let: should be eating type specifier\n");
+            TRACE(TRACE_PARSER, "parse_let: should be eating type specifier\n");
             this->_next_token(); // eat the type specifier
-            ident_tok = this->current_token; // grab the identifier
+            ident_tok = this->_current(); // grab the identifier
             if (ident_tok.type != TOK_IDENT) {
-                printf("error: unexpected token |%s|. Expected |TOK_IDENT|\n", ident_tok.literal.c_str());
+                char err[100];
+                snprintf(err, sizeof(err), "unexpected token |" SV_FMT "|. Expected |TOK_IDENT|", SV_ARG(ident_tok.literal));
+                this->error_handler->new_error(ident_tok.offset, err);
+                this->_skip_statement();
                 return nullptr;
             }
         }
-        printf("parse_let: should be eating identifier\n");
+        TRACE(TRACE_PARSER, "parse_let: should be eating identifier\n");
         this->_next_token(); // eat the identifier
     }
 
 
     // Parse the expression the variable is being initialized to
-    if (this->current_token.type == TOK_EQUALS) {
+    if (this->_current().type == TOK_EQUALS) {
         // Variable declaration and assignment
-        token_t op = this->current_token;
-        printf("parse_let: should be eating '='\n");
+        token_t op = this->_current();
+        TRACE(TRACE_PARSER, "parse_let: should be eating '='\n");
         this->_next_token(); // eat the '='
 
-        auto expr_val = this->_parse_expression_interior(); // get the expression being set to the variable
-        auto variable = std::make_shared<VariableExpr>(ident_tok.literal, data_type);
-        auto assignment_expr = std::make_shared<VariableAssignment>(op, variable, std::move(expr_val));
-
-        if (this->current_token.type == TOK_SEMICOLON) {
-            printf("parse_let: should be eating ';'\n");
+        // the variable goes first -- it is the first operand of the assignment
+        symbol_t name = this->_symbol(ident_tok);
+        expr_node_t variable = expr_node(NODE_VARIABLE, data_type);
+        variable.name = name;
+        expr_node_t assignment = expr_node(NODE_ASSIGNMENT, data_type);
+        assignment.op = op.type;
+        assignment.children[0] = this->exprs->add(variable);
+        assignment.children[1] = this->_parse_expression_interior(); // get the expression being set to the variable
+        expr_t assignment_expr = this->exprs->add(assignment);
+
+        if (this->_current().type == TOK_SEMICOLON) {
+            TRACE(TRACE_PARSER, "parse_let: should be eating ';'\n");
             this->_next_token();
         }
         else
-            printf("let_stmt: curtok = '%s'\n", this->current_token.literal.c_str());
+            TRACE(TRACE_PARSER, "let_stmt: curtok = '" SV_FMT "'\n", SV_ARG(this->_current().literal));
 
-        return std::make_shared<LetStmt>(let_tok, std::move(variable), std::move(assignment_expr));
-    } else if (this->current_token.type == TOK_SEMICOLON) {
+        return this->arena->make<LetStmt>(let_tok, name, data_type, this->exprs->table, assignment_expr);
+    } else if (this->_current().type == TOK_SEMICOLON) {
         // Variable declaration -- we do not allow declarations without initializations
-        printf("parse_let: error: variable '%s' missing initialization\n", ident_tok.literal.c_str());
-
-        token_t op;
-        op.literal = "=";
-        op.type = TOK_EQUALS;
-
-        auto expr = std::make_shared<Expression>();
-        auto variable = std::make_shared<VariableExpr>(ident_tok.literal, data_type);
-        auto assignment_expr = std::make_shared<VariableAssignment>(op, variable, expr);
-
-        printf("parse_let: should be eating ';'\n");
+        char err[100];
+        snprintf(err, sizeof(err), "variable '" SV_FMT "' missing initialization", SV_ARG(ident_tok.literal));
+        this->error_handler->new_error(ident_tok.offset, err);
+
+        symbol_t name = this->_symbol(ident_tok);
+        expr_node_t variable = expr_node(NODE_VARIABLE, data_type);
+        variable.name = name;
+        expr_node_t assignment = expr_node(NODE_ASSIGNMENT, data_type);
+        assignment.op = TOK_EQUALS;
+        assignment.children[0] = this->exprs->add(variable);
+        assignment.children[1] = this->exprs->add(expr_node(NODE_EMPTY, TYPE_VOID));
+        expr_t assignment_expr = this->exprs->add(assignment);
+
+        TRACE(TRACE_PARSER, "parse_let: should be eating ';'\n");
         this->_next_token();
 
-        return std::make_shared<LetStmt>(let_tok, variable, std::move(assignment_expr));
+        return this->arena->make<LetStmt>(let_tok, name, data_type, this->exprs->table, assignment_expr);
     } else {
-        printf("error: unexpected token |%s|. Expected |=|\n", this->current_token.literal.c_str());
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token |" SV_FMT "|. Expected |=|", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+        this->_skip_statement();
         return nullptr;
     }
 }
@@ -211,93 +415,102 @@ Parser::_parse_let_statement() {
 
 // Parse an integer expression -- really just an integer literal
 // "3" "700";
-std::shared_ptr<Expression>
+expr_t
 Parser::_parse_integer() {
-    token_t tok = this->current_token;
+    token_t tok = this->_current();
     if (tok.type != TOK_INT) {
         char err[100];
-        sprintf(err, "Error: expected |int|. Got |%s|\n", tok.literal.c_str());
-        this->error_handler->new_error(tok.line_num, err);
-        return std::make_shared<IntegerExpr>(-1);
+        sprintf(err, "Error: expected |int|. Got |" SV_FMT "|\n", SV_ARG(tok.literal));
+        this->error_handler->new_error(tok.offset, err);
+        expr_node_t node = expr_node(NODE_INTEGER, TYPE_INT);
+        node.int_value = -1;
+        return this->exprs->add(node);
     }
 
-    long long val = atoi(tok.literal.c_str());
-    printf("matched int: val = %lld\n", val);
+    long long val = tok.value.int_value;
+    TRACE(TRACE_PARSER, "matched int: val = %lld\n", val);
 
-    printf("parse_int: should be eating int literal\n");
+    TRACE(TRACE_PARSER, "parse_int: should be eating int literal\n");
     this->_next_token();
 
-    auto int_expr = std::make_shared<IntegerExpr>(val);
-    int_expr->data_type = TYPE_INT;
+    expr_node_t int_expr = expr_node(NODE_INTEGER, TYPE_INT);
+    int_expr.int_value = val;
 
-    return int_expr;
+    return this->exprs->add(int_expr);
 }
 
 // Parse a byte expression -- a byte literal [char in C]
-std::shared_ptr<Expression>
+expr_t
 Parser::_parse_byte() {
-    token_t tok = this->current_token;
+    token_t tok = this->_current();
     if (tok.type != TOK_INT) {
         char err[100];
-        sprintf(err, "Error: expected |byte|. Got |%s|\n", tok.literal.c_str());
-        this->error_handler->new_error(tok.line_num, err);
-        return std::make_shared<ByteExpr>(-1);
+        sprintf(err, "Error: expected |byte|. Got |" SV_FMT "|\n", SV_ARG(tok.literal));
+        this->error_handler->new_error(tok.offset, err);
+        expr_node_t node = expr_node(NODE_BYTE, TYPE_BYTE);
+        node.int_value = -1;
+        return this->exprs->add(node);
     }
 
-    long long val = atoi(tok.literal.c_str());
-    printf("matched int: val = %lld\n", val);
+    long long val = tok.value.int_value;
+    TRACE(TRACE_PARSER, "matched int: val = %lld\n", val);
 
-    printf("parse_int: should be eating int literal\n");
+    TRACE(TRACE_PARSER, "parse_int: should be eating int literal\n");
     this->_next_token();
 
-    auto byte_expr = std::make_shared<ByteExpr>(val);
-    byte_expr->data_type = TYPE_BYTE;
+    expr_node_t byte_expr = expr_node(NODE_BYTE, TYPE_BYTE);
+    byte_expr.int_value = val;
 
-    return byte_expr;
+    return this->exprs->add(byte_expr);
 }
 
 // Parse a float expression -- really just a float literal
 // "3.0" "700.29"
-std::shared_ptr<Expression>
+expr_t
 Parser::_parse_float() {
-    token_t tok = this->current_token;
+    token_t tok = this->_current();
     if (tok.type != TOK_FLOAT) {
         char err[100];
-        sprintf(err, "Error: expected |float|. Got |%s|\n", tok.literal.c_str());
-        this->error_handler->new_error(tok.line_num, err);
-        return std::make_shared<FloatExpr>(-1);
+        sprintf(err, "Error: expected |float|. Got |" SV_FMT "|\n", SV_ARG(tok.literal));
+        this->error_handler->new_error(tok.offset, err);
+        expr_node_t node = expr_node(NODE_FLOAT, TYPE_FLOAT);
+        node.float_value = -1;
+        return this->exprs->add(node);
     }
 
-    double val = atof(tok.literal.c_str());
-    printf("matched float: val %lf\n", val);
+    double val = tok.value.float_value;
+    TRACE(TRACE_PARSER, "matched float: val %lf\n", val);
 
-    printf("_parse_float: should be eating float literal\n");
+    TRACE(TRACE_PARSER, "_parse_float: should be eating float literal\n");
     this->_next_token();
 
-    auto float_expr = std::make_shared<FloatExpr>(val);
-    float_expr->data_type = TYPE_FLOAT;
+    expr_node_t float_expr = expr_node(NODE_FLOAT, TYPE_FLOAT);
+    float_expr.float_value = val;
 
-    return float_expr;
+    return this->exprs->add(float_expr);
 }
 
 // Parse a boolean expression -- boolean literal
 // "true" "false"
-std::shared_ptr<Expression>
+expr_t
 Parser::_parse_boolean() {
-    token_t tok = this->current_token;
+    token_t tok = this->_current();
 
     if (tok.type != TOK_TRUE && tok.type != TOK_FALSE) {
         char err[100];
-        sprintf(err, "Error: expected |true| or |false|. Got |%s|\n", tok.literal.c_str());
-        this->error_handler->new_error(tok.line_num, err);
-        return std::make_shared<BooleanExpr>(false);
+        sprintf(err, "Error: expected |true| or |false|. Got |" SV_FMT "|\n", SV_ARG(tok.literal));
+        this->error_handler->new_error(tok.offset, err);
+        return this->exprs->add(expr_node(NODE_BOOLEAN, TYPE_BOOL));
     }
 
-    printf("_parse_boolean: should be eating 'true' or 'false'\n");
+    TRACE(TRACE_PARSER, "_parse_boolean: should be eating 'true' or 'false'\n");
     this->_next_token();
 
     bool val = (tok.type == TOK_TRUE) ? true : false;
-    return std::make_shared<BooleanExpr>(val);
+    expr_node_t bool_expr = expr_node(NODE_BOOLEAN, TYPE_BOOL);
+    bool_expr.int_value = val;
+
+    return this->exprs->add(bool_expr);
 }
 
 ///////////////////////////////////////////////
@@ -306,51 +519,57 @@ Parser::_parse_boolean() {
 
 // Parse return statements from a function body
 // "return 0;"
-std::shared_ptr<Statement>
+Statement*
 Parser::_parse_return_statement() {
-    token_t return_tok = this->current_token;
+    token_t return_tok = this->_current();
 
-    printf("parse_return: should be eating 'return'\n");
+    TRACE(TRACE_PARSER, "parse_return: should be eating 'return'\n");
     this->_next_token(); // eat return token
                                             
     auto return_val = this->_parse_expression_interior(); // get the expression it is returning
 
-    printf("parse_return: should be eating ';'\n");
-    this->_next_token(); // eat the ';'
+    if (this->_current().type != TOK_SEMICOLON) {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected ';'", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+    } else {
+        TRACE(TRACE_PARSER, "parse_return: should be eating ';'\n");
+        this->_next_token(); // eat the ';'
+    }
                                              
-    return std::make_shared<ReturnStmt>(return_tok, return_val);
+    return this->arena->make<ReturnStmt>(return_tok, this->exprs->table, return_val);
 }
 
 // Parse a function definition
 // functions are required to be defined where they are declared,
 // so when we parse the prototype, the rest of the definition must follow
-std::shared_ptr<Statement>
+Statement*
 Parser::_parse_function_defn() {
     bool is_entry = false;
-    token_t decl_keyword = this->current_token;
+    token_t decl_keyword = this->_current();
 
     // Ensure correct keyword
     // this function should only be called when the 'define' or 'entry' tokens are read,
     // so this ideally should not happen but it is nice to check for debugging
-    if (this->current_token.type != TOK_ENTRY && 
-        this->current_token.type != TOK_FUNCTION
+    if (this->_current().type != TOK_ENTRY && 
+        this->_current().type != TOK_FUNCTION
     ) {
         // Missing 'define' keyword to declare a function
         char err[100];
-        sprintf(err, "Error: When parsing function: unexpected token |%s|. Expected |define| or |entry|\n", this->current_token.literal.c_str());
-        this->error_handler->new_error(this->current_token.line_num, err);
+        sprintf(err, "Error: When parsing function: unexpected token |" SV_FMT "|. Expected |define| or |entry|\n", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
     } else {
         // Correct Syntax
-        if (this->current_token.type == TOK_ENTRY)
+        if (this->_current().type == TOK_ENTRY)
             is_entry = true;
 
-        printf("parse_func: should be eating 'function' or 'define' or 'entry'\n");
+        TRACE(TRACE_PARSER, "parse_func: should be eating 'function' or 'define' or 'entry'\n");
         this->_next_token(); // eat the "function" or "define" or "entry" keyword
     }
 
 
     // GET TYPE SPECIFIER //
-    token_t tok = this->current_token;
+    token_t tok = this->_current();
     DataType rt;
     if (tok.type == TOK_TYPEINT) {
         rt = TYPE_INT;
@@ -365,104 +584,114 @@ Parser::_parse_function_defn() {
         rt = TYPE_VOID;
     } else {
         char err[100];
-        sprintf(err, "Error: When parsing function: unexpected token |%s|\n. Expected type declaration", tok.literal.c_str());
-        this->error_handler->new_error(tok.line_num, err);
+        sprintf(err, "Error: When parsing function: unexpected token |" SV_FMT "|\n. Expected type declaration", SV_ARG(tok.literal));
+        this->error_handler->new_error(tok.offset, err);
         rt = TYPE_VOID;
     }
 
     // GET IDENTIFIER //
-    std::string proto_name;
+    symbol_t proto_name = intern("");
     token_t ident;
     if (rt != TYPE_VOID) {
         // Function has valid return type specification
-        printf("parse_func: should be eating type spec\n");
+        TRACE(TRACE_PARSER, "parse_func: should be eating type spec\n");
         this->_next_token(); // eat the type specifier
 
-        ident = this->current_token;
+        ident = this->_current();
         if (ident.type != TOK_IDENT) {
             // Missing function name identifier
             char err[100];
-            sprintf(err, "error: unexpected token '%s'. Expected IDENT\n", ident.literal.c_str());
-            this->error_handler->new_error(ident.line_num, err);
+            sprintf(err, "error: unexpected token '" SV_FMT "'. Expected IDENT\n", SV_ARG(ident.literal));
+            this->error_handler->new_error(ident.offset, err);
             ident.literal = "_VOID_FUNC_NAME_";
         } else {
-            printf("parse_func: should be eating identifier\n");
+            TRACE(TRACE_PARSER, "parse_func: should be eating identifier\n");
             this->_next_token(); // eat the identifier
         }
 
-        proto_name = ident.literal;
+        proto_name = this->_symbol(ident);
     } else {
         // Invalid return type specification
         // Either they forgot it, or they mispelled it
-        if (this->peek_token.type == TOK_IDENT) {
+        if (this->_peek(1).type == TOK_IDENT) {
             // next token is identifier after missed type_spec
             // assume they mispelled it
-            printf("parse_func: should be eating type spec\n");
+            TRACE(TRACE_PARSER, "parse_func: should be eating type spec\n");
             this->_next_token(); // eat the type specifer
 
             char err[100];
-            sprintf(err, "parse_func_defn: error on line %d: mispelled return type specifier '%s'\n", tok.line_num, tok.literal.c_str());
-            this->error_handler->new_error(this->current_token.line_num, err);
-            ident = this->current_token;
+            sprintf(err, "parse_func_defn: error on line %zu: mispelled return type specifier '" SV_FMT "'\n", this->error_handler->line(tok.offset), SV_ARG(tok.literal));
+            this->error_handler->new_error(this->_current().offset, err);
+            ident = this->_current();
 
             if (ident.type != TOK_IDENT) {
                 char err[100];
-                sprintf(err, "Error: unexpected token '%s'. Expected 'IDENT'\n", ident.literal.c_str());
-                this->error_handler->new_error(ident.line_num, err);
+                sprintf(err, "Error: unexpected token '" SV_FMT "'. Expected 'IDENT'\n", SV_ARG(ident.literal));
+                this->error_handler->new_error(ident.offset, err);
                 // return std::make_shared<FunctionDecl>();
-                proto_name = "_VOID_FUNC_NAME_";
+                proto_name = intern("_VOID_FUNC_NAME_");
             } else {
-                proto_name = ident.literal;
+                proto_name = ident.value.symbol;
             }
 
-        } else if (this->peek_token.type == TOK_LPAREN) {
+        } else if (this->_peek(1).type == TOK_LPAREN) {
             // next token is opening parentheses
             // assume they forgot the return type specifier
-            printf("parse_func_defn: error: missing return type specifier for '%s'\n", tok.literal.c_str());
-            proto_name = tok.literal;
+            char err[100];
+            snprintf(err, sizeof(err), "missing return type specifier for '" SV_FMT "'", SV_ARG(tok.literal));
+            this->error_handler->new_error(tok.offset, err);
+            proto_name = this->_symbol(tok);
             ident = tok;
         }
 
         if (ident.type != TOK_IDENT) {
             // Missing function name identifier
             char err[100];
-            sprintf(err, "error: unexpected token '%s'. Expected IDENT\n", ident.literal.c_str());
-            this->error_handler->new_error(ident.line_num, err);
+            sprintf(err, "error: unexpected token '" SV_FMT "'. Expected IDENT\n", SV_ARG(ident.literal));
+            this->error_handler->new_error(ident.offset, err);
             ident.literal = "_VOID_FUNC_NAME_";
         } else {
-            printf("parse_func: should be eating identifier\n");
+            TRACE(TRACE_PARSER, "parse_func: should be eating identifier\n");
             this->_next_token(); // eat the identifier
         }
     }
 
                                             
     // PARSE FUNCTION PARAMETERS //
-    if (this->current_token.type != TOK_LPAREN) {
-        printf("error: unexpected token '%s'. Expected '('\n", this->current_token.literal.c_str());
+    bool has_lparen = (this->_current().type == TOK_LPAREN);
+    if (!has_lparen) {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected '('", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+    } else {
+        TRACE(TRACE_PARSER, "parse_func: should be eating '('\n");
+        this->_next_token(); // eat the '('
     }
-
-    printf("parse_func: should be eating '('\n");
-    this->_next_token(); // eat the '('
                                             
-    auto func_body = std::make_shared<CodeBlock>(); // code block of the function body
+    auto func_body = this->arena->make<CodeBlock>(this->arena); // code block of the function body
 
-    std::vector<IdentifierExpr> params;
-    while(this->current_token.type != TOK_RPAREN) {
-        token_t param_type = this->current_token;
-        if (param_type.type == TOK_RPAREN) 
-            break;
+    // The list ends at its ')', or where the body or the next function starts if the ')' is missing
+    std::vector<parameter_t> params;
+    while (this->_current().type != TOK_RPAREN && !this->_at(SYNC_FUNCTION | token_set({TOK_LBRACE}))) {
+        token_t param_type = this->_current();
 
-        printf("parse_func: should be eating param type spec\n");
+        TRACE(TRACE_PARSER, "parse_func: should be eating param type spec\n");
         this->_next_token(); // eat the parameter's type spec
 
-        token_t param_name = this->current_token;
+        token_t param_name = this->_current();
         if (param_name.type != TOK_IDENT) {
-            printf("error: unexpected token '%s'. Expected IDENT\n", param_name.literal.c_str());
-            return nullptr;
+            // Drop the parameter and go on with the next one
+            char err[100];
+            snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected IDENT", SV_ARG(param_name.literal));
+            this->error_handler->new_error(param_name.offset, err);
+            this->_synchronize(SYNC_PARAMETER);
+            if (this->_current().type == TOK_COMMA)
+                this->_next_token();
+            continue;
         }
 
-        IdentifierExpr identifier;
-        identifier.name = param_name.literal;
+        parameter_t identifier;
+        identifier.name = param_name.value.symbol;
         if (param_type.type == TOK_TYPEINT) {
             identifier.data_type = TYPE_INT;
         } else if (param_type.type == TOK_TYPEFLOAT) {
@@ -472,220 +701,354 @@ Parser::_parse_function_defn() {
         } else if (param_type.type == TOK_TYPEBOOL) {
             identifier.data_type = TYPE_BOOL;
         } else {
-            printf("error: unexpected token '%s'\n. Expected 'int' or 'float'", tok.literal.c_str());
+            char err[100];
+            snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected a parameter type", SV_ARG(param_type.literal));
+            this->error_handler->new_error(param_type.offset, err);
+            identifier.data_type = TYPE_VOID;
         }
 
         // Add the parameter to the list
         params.push_back(identifier);
-        auto param_ste = identifier._get_st_entry();
-        func_body->symbol_table->add(param_ste);
+        auto param_ste = this->arena->make<SymbolTableEntry>(identifier.name, identifier.data_type, 64, 1, 1);
+        func_body->symbol_table.add(param_ste);
 
-        printf("parse_func: should be eating param identifier\n");
+        TRACE(TRACE_PARSER, "parse_func: should be eating param identifier\n");
         this->_next_token(); // eat the identifier
 
         // If there is a comma, assume there is another param
         // and continue the loop. If not a comma, see if we have 
         // a right-paren and if not we have an error
-        if (this->current_token.type != TOK_COMMA) {
-            if (this->current_token.type == TOK_RPAREN)
+        if (this->_current().type != TOK_COMMA) {
+            if (this->_current().type == TOK_RPAREN)
                 break;
 
-            printf("error: unexpected token '%s'. Expected ','\n", this->current_token.literal.c_str());
+            char err[100];
+            snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected ','", SV_ARG(this->_current().literal));
+            this->error_handler->new_error(this->_current().offset, err);
         } else {
-            printf("parse_func: should be eating ','\n");
+            TRACE(TRACE_PARSER, "parse_func: should be eating ','\n");
             this->_next_token(); // eat the ','
         }
     }
 
-    printf("parse_func: should be eating ')'\n");
-    this->_next_token(); // eat the ')' at end of parameter list
+    if (this->_current().type == TOK_RPAREN) {
+        TRACE(TRACE_PARSER, "parse_func: should be eating ')'\n");
+        this->_next_token(); // eat the ')' at end of parameter list
+    } else if (has_lparen) {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected ')'", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+    }
 
     // FUNCTION BODY //
+    // Its expressions go into a table of its own
+    expr_builder_t *outer = this->exprs;
+    this->_begin_exprs(&this->function_exprs);
     this->_parse_code_block(func_body);
+    ExprTable *exprs = this->exprs->table;
+    this->_finish_exprs();
+    this->exprs = outer;
 
-    auto proto = std::make_shared<Prototype>(proto_name, rt, params);
-    auto function = std::make_shared<FunctionDecl>(is_entry, std::move(func_body), std::move(proto));
+    auto proto = this->arena->make<Prototype>(proto_name, rt, this->arena->list(params));
+    auto function = this->arena->make<FunctionDecl>(is_entry, func_body, proto, exprs);
 
     return function;
 }
 
-/////////////////////////////////////////////////////////
-//                    CODE BLOCKS                      //
-/////////////////////////////////////////////////////////
-
-// Parse a code block
-std::shared_ptr<Statement>
-Parser::_parse_code_block() {
-    token_t tok = this->current_token;
-    if (tok.type != TOK_LBRACE) {
-        printf("parse_code_block: error: unexpected token '%s'. Expected '{'\n", tok.literal.c_str());
+// Parse a top-level function definition
+// Functions that were parsed ahead of time -- on the pool or by an earlier parse -- are
+// taken as they are and the parser skips to the end of them. A function parsed here that
+// parses cleanly and ends at the end of its span is recorded in parsed_functions too, so
+// the parse cache can remember it.
+Statement*
+Parser::_parse_top_level_function() {
+    // skip the spans an error already carried the parse past
+    size_t index = this->_token_index();
+    while (this->next_parsed_function < this->function_spans.size() && this->function_spans[this->next_parsed_function].begin < index)
+        this->next_parsed_function++;
+    if (this->next_parsed_function == this->function_spans.size() || this->function_spans[this->next_parsed_function].begin != index)
+        return this->_parse_function_defn();
+
+    size_t i = this->next_parsed_function++;
+    const function_span_t &span = this->function_spans[i];
+    if (this->parsed_functions[i] != nullptr) {
+        this->_seek(span.end);
+        return this->parsed_functions[i];
     }
 
-    printf("parse_code_block: should be eating '{'\n");
-    this->_next_token();
-
-    auto code_block = std::make_shared<CodeBlock>();
-    auto symbol_table = std::make_shared<SymbolTable>();
-    std::vector <std::shared_ptr<Statement> > body;
+    size_t errors = this->error_handler->error_log.size();
+    Statement* function = this->_parse_function_defn();
+    if (function != nullptr && this->error_handler->error_log.size() == errors && this->_token_index() == span.end)
+        this->parsed_functions[i] = cast<FunctionDecl>(function);
+    return function;
+}
 
-    while (this->current_token.type != TOK_RBRACE) {
-        // for now: eat the body
-        std::shared_ptr<Statement> stmt;
-        std::shared_ptr<SymbolTableEntry> symbol_table_entry;
-        switch (this->current_token.type) {
-            case TOK_LET:
-                printf("let token: ||%s||\n", this->current_token.literal.c_str());
-                stmt = this->_parse_let_statement();
+// Pre-scan the token buffer for the top-level functions after the current token
+// A function runs from its keyword to the '}' matching the first '{' after it. Only the
+// token types are looked at, so this is far cheaper than parsing. Anything that does not
+// look like a run of well formed functions -- a keyword with no body, braces outside of a
+// function or braces that never close -- finds nothing, and the program is parsed in order.
+std::vector <function_span_t>
+Parser::_find_functions() {
+    std::vector <function_span_t> spans;
+    const TokenBuffer &tokens = *this->token_stream.buffer;
+    size_t size = tokens.size();
+
+    for (size_t i = this->_token_index(); i < size; i++) {
+        TokenType type = tokens.type(i);
+        if (type == TOK_LBRACE || type == TOK_RBRACE)
+            return {};
+        if (type != TOK_FUNCTION && type != TOK_ENTRY)
+            continue;
+
+        // the prototype up to the body
+        size_t begin = i;
+        for (i++; i < size && tokens.type(i) != TOK_LBRACE; i++) {
+            type = tokens.type(i);
+            if (type == TOK_FUNCTION || type == TOK_ENTRY || type == TOK_RBRACE || type == TOK_EOF)
+                return {};
+        }
 
-                // Check if variable has been declared already -- CLEAN UP -- ACTUALLY MAKE THIS ERROR
-                if (code_block->symbol_table->find(dynamic_cast<VariableExpr*>(dynamic_cast<LetStmt*>(stmt.get())->variable.get())->name) == true) {
-                    std::string name = dynamic_cast<VariableExpr*>(dynamic_cast<LetStmt*>(stmt.get())->variable.get())->name;
-                    char buf[200];
-                    sprintf(buf, "parse_code_block: error: redeclaration of |%s| in this scope", name.c_str());
-                    this->error_handler->new_error(dynamic_cast<LetStmt*>(stmt.get())->token.line_num, buf);
+        // the body up to its matching '}'
+        size_t depth = 0;
+        for (; i < size; i++) {
+            type = tokens.type(i);
+            if (type == TOK_LBRACE) {
+                depth++;
+            } else if (type == TOK_RBRACE) {
+                if (--depth == 0)
                     break;
-                }
+            } else if (type == TOK_EOF) {
+                return {};
+            }
+        }
+        if (i >= size)
+            return {};
 
-                // Variable is being properly declared, add to ast
-                symbol_table_entry = dynamic_cast<LetStmt*>(stmt.get())->_get_st_entry();
-                code_block->symbol_table->add(std::move(symbol_table_entry));
-                body.push_back(std::move(stmt));
-                break;
+        spans.push_back(function_span_t{begin, i + 1});
+    }
 
-            case TOK_IF:
-                printf("if token: ||%s||\n", this->current_token.literal.c_str());
-                stmt = this->_parse_if_statement();
-                body.push_back(std::move(stmt));
-                break;
+    return spans;
+}
 
-            case TOK_WHILE:
-                printf("while token: ||%s||\n", this->current_token.literal.c_str());
-                stmt = this->_parse_while_statement();
-                body.push_back(std::move(stmt));
+// Parse the functions in function_spans that are not in parsed_functions yet on the pool
+// The functions are split into runs of neighbours, one run per job. Every job parses its
+// functions with a parser, arena and error handler of its own, so the workers share
+// nothing but the token buffer. The arenas are handed over to this parser's arena once
+// every job is done.
+// A function parsed on its own only matches what parsing it in the middle of the program
+// would have given when it has no errors and ends exactly at its closing '}'. If any
+// function does not, none of the pool's functions are used and they are parsed in order,
+// which also keeps the errors in the order they are found.
+void
+Parser::_parse_functions_parallel() {
+    const std::vector <function_span_t> &spans = this->function_spans;
+    std::vector <size_t> todo;
+    for (size_t i = 0; i < spans.size(); i++) {
+        if (this->parsed_functions[i] == nullptr)
+            todo.push_back(i);
+    }
+    if (todo.size() < 2)
+        return;
+
+    size_t job_count = std::min(todo.size(), this->pool->size() * 4);
+    std::vector <FunctionDecl*> functions = this->parsed_functions;
+    std::vector <Arena> arenas(job_count);
+    std::vector <char> failed(job_count, 0);
+
+    this->pool->run(job_count, [&](size_t job) {
+        ErrorHandler errors;
+        size_t last = todo.size() * (job + 1) / job_count;
+        for (size_t t = todo.size() * job / job_count; t < last; t++) {
+            size_t i = todo[t];
+            Parser parser(*this->token_stream.buffer, spans[i].begin, spans[i].end);
+            parser.arena = &arenas[job];
+            parser.error_handler = &errors;
+            parser.symbol_table = this->symbol_table;
+
+            functions[i] = dyn_cast<FunctionDecl>(parser._parse_function_defn());
+            if (functions[i] == nullptr || parser._current().type != TOK_EOF || !errors.error_log.empty()) {
+                failed[job] = 1;
                 break;
+            }
+        }
+    });
 
-            case TOK_FOR:
-                printf("for token: ||%s||\n", this->current_token.literal.c_str());
-                stmt = this->_parse_for_statement();
-                body.push_back(std::move(stmt));
-                break;
+    if (std::find(failed.begin(), failed.end(), 1) != failed.end()) {
+        TRACE(TRACE_PARSER, "parse_functions_parallel: falling back to parsing in order\n");
+        return;
+    }
 
-            case TOK_RETURN:
-                printf("return token: ||%s||\n", this->current_token.literal.c_str());
-                stmt = this->_parse_return_statement();
-                body.push_back(std::move(stmt));
-                break;
+    for (Arena &arena : arenas)
+        this->arena->adopt(arena);
+    this->parsed_functions = std::move(functions);
+    TRACE(TRACE_PARSER, "parse_functions_parallel: %zu functions in %zu jobs\n", todo.size(), job_count);
+}
 
-            default:
-                printf("default token: ||%s|| -- |%d|\n", this->current_token.literal.c_str(), this->current_token.type);
-                if (this->current_token.literal == "")
-                    goto cb_endloop;
-                stmt = this->_parse_expression_statement();
-                body.push_back(std::move(stmt));
-                break;
-        }
-        
+// Fingerprint the functions in function_spans and splice in the ones the cache remembers
+// The fingerprint of the globals covers every token outside of the function bodies --
+// top-level lets and every prototype -- which is all a function's syntax analysis sees of
+// the rest of the program.
+void
+Parser::_reuse_functions() {
+    const TokenBuffer &tokens = *this->token_stream.buffer;
+    const std::vector <function_span_t> &spans = this->function_spans;
+
+    uint64_t globals = 0;
+    size_t outside = this->_token_index();
+    this->function_fingerprints.resize(spans.size());
+    for (size_t i = 0; i < spans.size(); i++) {
+        size_t body = spans[i].begin;
+        while (tokens.type(body) != TOK_LBRACE)
+            body++;
+        globals = fingerprint_tokens(tokens, outside, body, globals);
+        outside = spans[i].end;
+
+        this->function_fingerprints[i] = fingerprint_tokens(tokens, spans[i].begin, spans[i].end);
+    }
+    globals = fingerprint_tokens(tokens, outside, tokens.size(), globals);
+
+    this->program->globals_changed = (globals != this->cache->globals);
+    this->cache->globals = globals;
+    this->cache->reused = 0;
+    if (this->cache->full()) {
+        TRACE(TRACE_PARSER, "reuse_functions: cache is full, parsing everything\n");
+        return;
     }
-    cb_endloop:
 
-    code_block->body = std::move(body);
+    for (size_t i = 0; i < spans.size(); i++) {
+        FunctionDecl *function = this->cache->take(this->function_fingerprints[i]);
+        if (function == nullptr)
+            continue;
+        function->reused = true;
+        this->parsed_functions[i] = function;
+        this->cache->reused++;
+    }
+    TRACE(TRACE_PARSER, "reuse_functions: %zu of %zu functions reused\n", this->cache->reused, spans.size());
+}
 
-    if (this->current_token.type != TOK_RBRACE) {
-        // Missing closing '}'
-        this->error_handler->new_error(this->current_token.line_num, "missing closing '}'");
-    } else {
-        printf("parse_code_block: should be eating '}'\n");
-        this->_next_token();
+// Have the cache remember the functions of this parse that parsed cleanly
+void
+Parser::_remember_functions() {
+    this->cache->functions.clear();
+    for (size_t i = 0; i < this->function_spans.size(); i++) {
+        if (this->parsed_functions[i] != nullptr)
+            this->cache->functions.emplace(this->function_fingerprints[i], this->parsed_functions[i]);
     }
+    this->cache->parsed = this->function_spans.size() - this->cache->reused;
+}
 
+/////////////////////////////////////////////////////////
+//                    CODE BLOCKS                      //
+/////////////////////////////////////////////////////////
 
-    return code_block; 
+// Parse a code block
+Statement*
+Parser::_parse_code_block() {
+    auto code_block = this->arena->make<CodeBlock>(this->arena);
+    return this->_parse_code_block(code_block);
 }
 
 
 // Parse a code block
-std::shared_ptr<Statement>
-Parser::_parse_code_block(std::shared_ptr<CodeBlock> scope) {
-    token_t tok = this->current_token;
+Statement*
+Parser::_parse_code_block(CodeBlock* scope) {
+    token_t tok = this->_current();
     if (tok.type != TOK_LBRACE) {
         // Missing the opening '{'
         // Assume they missed it and continue as planned
-        this->error_handler->new_error(this->current_token.line_num, "missing opening '{'");
+        this->error_handler->new_error(this->_current().offset, "missing opening '{'");
     } else {
-        printf("parse_code_block: should be eating '{'\n");
+        TRACE(TRACE_PARSER, "parse_code_block: should be eating '{'\n");
         this->_next_token();
     }
 
+    // Past PARSER_MAX_DEPTH the block is skipped, blocks inside it and all
+    if (this->depth >= PARSER_MAX_DEPTH) {
+        this->error_handler->new_error(this->_current().offset, "code block nested too deeply");
+        for (size_t open = 0; !this->_at(SYNC_FUNCTION); this->_next_token()) {
+            if (this->_current().type == TOK_LBRACE)
+                open++;
+            else if (this->_current().type == TOK_RBRACE && open-- == 0)
+                break;
+        }
+    }
 
-    std::vector <std::shared_ptr<Statement> > body;
+    std::vector <Statement*> body;
+    this->depth++;
 
-    while (this->current_token.type != TOK_RBRACE) {
+    // A function keyword or the end of the input means the '}' is missing
+    while (this->_current().type != TOK_RBRACE && !this->_at(SYNC_FUNCTION)) {
         // for now: eat the body
-        std::shared_ptr<Statement> stmt;
-        std::shared_ptr<SymbolTableEntry> symbol_table_entry;
-        switch (this->current_token.type) {
+        Statement* stmt;
+        SymbolTableEntry* symbol_table_entry;
+        size_t eaten = this->tokens_eaten;
+        switch (this->_current().type) {
             case TOK_LET:
-                printf("let token: ||%s||\n", this->current_token.literal.c_str());
+                TRACE(TRACE_PARSER, "let token: ||" SV_FMT "||\n", SV_ARG(this->_current().literal));
                 stmt = this->_parse_let_statement();
+                if (stmt == nullptr)
+                    break;
 
                 // Check if variable has been declared already -- CLEAN UP -- ACTUALLY MAKE THIS ERROR
-                if (scope->symbol_table->find(dynamic_cast<VariableExpr*>(dynamic_cast<LetStmt*>(stmt.get())->variable.get())->name) == true) {
-                    std::string name = dynamic_cast<VariableExpr*>(dynamic_cast<LetStmt*>(stmt.get())->variable.get())->name;
+                if (scope->symbol_table.find(cast<LetStmt>(stmt)->name) == true) {
+                    symbol_t name = cast<LetStmt>(stmt)->name;
                     char buf[200];
-                    sprintf(buf, "parse_code_block: error: redeclaration of |%s| in this scope", name.c_str());
-                    this->error_handler->new_error(dynamic_cast<LetStmt*>(stmt.get())->token.line_num, buf);
+                    sprintf(buf, "parse_code_block: error: redeclaration of |%s| in this scope", symbol_name(name).c_str());
+                    this->error_handler->new_error(cast<LetStmt>(stmt)->token.offset, buf);
                     break;
                 }
 
                 // Variable is being properly declared, add to ast
-                symbol_table_entry = dynamic_cast<LetStmt*>(stmt.get())->_get_st_entry();
-                scope->symbol_table->add(std::move(symbol_table_entry));
-                body.push_back(std::move(stmt));
+                symbol_table_entry = cast<LetStmt>(stmt)->_get_st_entry(this->arena);
+                scope->symbol_table.add(symbol_table_entry);
+                body.push_back(stmt);
                 break;
             
             case TOK_IF:
-                printf("if token: ||%s||\n", this->current_token.literal.c_str());
+                TRACE(TRACE_PARSER, "if token: ||" SV_FMT "||\n", SV_ARG(this->_current().literal));
                 stmt = this->_parse_if_statement();
-                body.push_back(std::move(stmt));
+                body.push_back(stmt);
                 break;
             
             case TOK_WHILE:
-                printf("while token: ||%s||\n", this->current_token.literal.c_str());
+                TRACE(TRACE_PARSER, "while token: ||" SV_FMT "||\n", SV_ARG(this->_current().literal));
                 stmt = this->_parse_while_statement();
-                body.push_back(std::move(stmt));
+                body.push_back(stmt);
                 break;
             
             case TOK_FOR:
-                printf("for token: ||%s||\n", this->current_token.literal.c_str());
+                TRACE(TRACE_PARSER, "for token: ||" SV_FMT "||\n", SV_ARG(this->_current().literal));
                 stmt = this->_parse_for_statement();
-                body.push_back(std::move(stmt));
+                body.push_back(stmt);
                 break;
 
             case TOK_RETURN:
-                printf("return token: ||%s||\n", this->current_token.literal.c_str());
+                TRACE(TRACE_PARSER, "return token: ||" SV_FMT "||\n", SV_ARG(this->_current().literal));
                 stmt = this->_parse_return_statement();
-                body.push_back(std::move(stmt));
+                body.push_back(stmt);
                 break;
 
             default:
-                printf("default token: ||%s||\n", this->current_token.literal.c_str());
-                if (this->current_token.literal == "")
-                    goto cbp_endloop;
+                TRACE(TRACE_PARSER, "default token: ||" SV_FMT "||\n", SV_ARG(this->_current().literal));
                 stmt = this->_parse_expression_statement();
-                body.push_back(std::move(stmt));
+                body.push_back(stmt);
                 break;
         }
-        
+
+        // A token no statement can start with is skipped, so every pass eats at least one
+        if (this->tokens_eaten == eaten)
+            this->_next_token();
     }
-    cbp_endloop:
+    this->depth--;
 
-    scope->body = std::move(body);
+    scope->body = this->arena->list(body);
 
-    if (this->current_token.type != TOK_RBRACE) {
+    if (this->_current().type != TOK_RBRACE) {
         // Missing closing '}'
-        this->error_handler->new_error(this->current_token.line_num, "missing closing '}'");
+        this->error_handler->new_error(this->_current().offset, "missing closing '}'");
     } else {
-        printf("parse_code_block: should be eating '}'\n");
+        TRACE(TRACE_PARSER, "parse_code_block: should be eating '}'\n");
         this->_next_token();
     }
 
@@ -698,182 +1061,203 @@ Parser::_parse_code_block(std::shared_ptr<CodeBlock> scope) {
 /////////////////////////////////////////////////////////
 
 // Parse a for loop statement
-std::shared_ptr<Statement>
+Statement*
 Parser::_parse_for_statement() {
-    token_t for_token = this->current_token;
-    auto loop_body = std::make_shared<CodeBlock>();
+    token_t for_token = this->_current();
+    auto loop_body = this->arena->make<CodeBlock>(this->arena);
 
-    printf("for_stmt: should be eating 'for'\n");
+    TRACE(TRACE_PARSER, "for_stmt: should be eating 'for'\n");
     this->_next_token(); // eat the 'for'
 
     // FOR LOOP INIT, CONDITION, AND ACTION //
-    if (this->current_token.type != TOK_LPAREN) {
+    if (this->_current().type != TOK_LPAREN) {
         char err[60];
-        sprintf(err, "invalid token '%s'. Expected '('\n", this->current_token.literal.c_str());
+        sprintf(err, "invalid token '" SV_FMT "'. Expected '('\n", SV_ARG(this->_current().literal));
 
         // no '(', for error handling, pretend they had it and continue parsing
-        this->error_handler->new_error(this->current_token.line_num, err);
+        this->error_handler->new_error(this->_current().offset, err);
     }    else {
         // Successfully found '('
-        printf("for_stmt: should be eating '('\n");
+        TRACE(TRACE_PARSER, "for_stmt: should be eating '('\n");
         this->_next_token(); // eat the '('
     }
 
     // Parse the initialization and add it to the scope of the for loop
     // [FOR NOW] we only allow LetStmt.
     // [FUTURE]    allow other forms of initializations like setting other variables
-    auto initialization = this->_parse_let_statement(); 
-    auto init_ste = std::dynamic_pointer_cast<LetStmt>(initialization)->_get_st_entry();
-    loop_body->symbol_table->add(init_ste); 
+    Statement* initialization = nullptr;
+    if (this->_current().type == TOK_LET) {
+        initialization = this->_parse_let_statement();
+    } else {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected 'let'", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+        this->_skip_statement();
+    }
+    if (initialization != nullptr) {
+        auto init_ste = cast<LetStmt>(initialization)->_get_st_entry(this->arena);
+        loop_body->symbol_table.add(init_ste);
+    }
     
     auto condition = this->_parse_expression_interior();
 
-    printf("for_stmt: should be eating ';'\n");
-    this->_next_token();
+    if (this->_current().type != TOK_SEMICOLON) {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected ';'", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+    } else {
+        TRACE(TRACE_PARSER, "for_stmt: should be eating ';'\n");
+        this->_next_token();
+    }
     
     auto action = this->_parse_expression_interior();
-    if (this->current_token.type == TOK_SEMICOLON) { // optional semicolon at end of action
-        printf("for_stmt: should be eating ';'\n");
+    if (this->_current().type == TOK_SEMICOLON) { // optional semicolon at end of action
+        TRACE(TRACE_PARSER, "for_stmt: should be eating ';'\n");
         this->_next_token();
     }
 
-    printf("for_stmt: should be eating ')'\n");
-    this->_next_token();
+    if (this->_current().type != TOK_RPAREN) {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected ')'", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+        this->_synchronize(SYNC_EXPRESSION);
+    }
+    if (this->_current().type == TOK_RPAREN) {
+        TRACE(TRACE_PARSER, "for_stmt: should be eating ')'\n");
+        this->_next_token();
+    }
 
-    if (this->current_token.type == TOK_LBRACE) {
+    if (this->_current().type == TOK_LBRACE) {
         this->_parse_code_block(loop_body);
     } else {
-        this->error_handler->new_error(this->current_token.line_num, "Missing |{| when parsing for-loop");
+        this->error_handler->new_error(this->_current().offset, "Missing |{| when parsing for-loop");
     }
 
-    auto initialization_ste = dynamic_cast<LetStmt*>(initialization.get())->_get_st_entry();
-    dynamic_cast<CodeBlock*>(loop_body.get())->symbol_table->add(std::move(initialization_ste));
+    if (initialization != nullptr) {
+        auto initialization_ste = cast<LetStmt>(initialization)->_get_st_entry(this->arena);
+        cast<CodeBlock>(loop_body)->symbol_table.add(initialization_ste);
 
-    auto symbol_table_entry = std::dynamic_pointer_cast<LetStmt>(initialization)->_get_st_entry();
-    std::dynamic_pointer_cast<CodeBlock>(loop_body)->symbol_table->add(std::move(symbol_table_entry));
+        auto symbol_table_entry = cast<LetStmt>(initialization)->_get_st_entry(this->arena);
+        cast<CodeBlock>(loop_body)->symbol_table.add(symbol_table_entry);
+    }
 
-    auto for_stmt = std::make_shared<ForLoop>(for_token, std::move(initialization), std::move(condition), std::move(action), std::move(loop_body));
+    auto for_stmt = this->arena->make<ForLoop>(for_token, initialization, this->exprs->table, condition, action, loop_body);
 
     return for_stmt;
 }
 
 
 // Parse an while loop statement
-std::shared_ptr<Statement>
+Statement*
 Parser::_parse_while_statement() {
-    token_t token = this->current_token;
-    printf("while_stmt: should be eating 'while\n");
+    token_t token = this->_current();
+    TRACE(TRACE_PARSER, "while_stmt: should be eating 'while\n");
     this->_next_token(); // eat the 'while'
                                         
-    if (this->current_token.type != TOK_LPAREN) {
+    if (this->_current().type != TOK_LPAREN) {
         // Error: missing opening parentheses
         char err[100];
-        sprintf(err, "_parse_while: invalid token '%s'. Expected '('", this->current_token.literal.c_str());
-        this->error_handler->new_error(this->current_token.line_num, err);
+        sprintf(err, "_parse_while: invalid token '" SV_FMT "'. Expected '('", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
     } else {
-        printf("parse_while: should be eating '('\n");
+        TRACE(TRACE_PARSER, "parse_while: should be eating '('\n");
         this->_next_token();
     }
 
     // Parse loop condition
     auto condition = this->_parse_expression_interior();
 
-    if (this->current_token.type != TOK_RPAREN) {
+    if (this->_current().type != TOK_RPAREN) {
         // Error: missing closing parentheses
         char err[100];
-        sprintf(err, "invalid token '%s'. Expected ')'", this->current_token.literal.c_str());
-        this->error_handler->new_error(this->current_token.line_num, err);
+        sprintf(err, "invalid token '" SV_FMT "'. Expected ')'", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
 
-        while (this->current_token.type != TOK_RPAREN) {
-            if (this->current_token.type == TOK_LBRACE)
-                break;
-            printf("parse_while: eating invalid token\n");
-            this->_next_token();
-        }
+        this->_synchronize(SYNC_EXPRESSION);
 
-        if (this->current_token.type == TOK_RPAREN) {
-            printf("parse_while post err: should be eating ')'\n");
+        if (this->_current().type == TOK_RPAREN) {
+            TRACE(TRACE_PARSER, "parse_while post err: should be eating ')'\n");
             this->_next_token();
         }
     } else {
-        printf("parse_while: should be eating ')'\n");
+        TRACE(TRACE_PARSER, "parse_while: should be eating ')'\n");
         this->_next_token();
     }
 
 
     // Loop until we find opening brace
-//    while (this->current_token.type != TOK_LBRACE) {
+//    while (this->_current().type != TOK_LBRACE) {
 //        char err[100];
-//        sprintf(err, "invalid token '%s'. Expected '{'\n", this->current_token.literal.c_str());
-//        this->error_handler->new_error(this->current_token.line_num, err);
+//        sprintf(err, "invalid token '%s'. Expected '{'\n", this->_current().literal.c_str());
+//        this->error_handler->new_error(this->_current().offset, err);
 //        printf("parse_while: should be eating invalid token\n");
 //        this->_next_token();
 //    }
 
     // PARSE WHILE LOOP BODY //
-    auto loop_body = std::make_shared<CodeBlock>();
-    if (this->current_token.type == TOK_LBRACE) {
+    auto loop_body = this->arena->make<CodeBlock>(this->arena);
+    if (this->_current().type == TOK_LBRACE) {
         this->_parse_code_block(loop_body);
     } else {
-        this->error_handler->new_error(this->current_token.line_num, "Missing '{' when parsing while loop");
+        this->error_handler->new_error(this->_current().offset, "Missing '{' when parsing while loop");
     }
 
     
-    auto while_stmt = std::make_shared<WhileLoop>(token, std::move(condition), std::move(loop_body));
+    auto while_stmt = this->arena->make<WhileLoop>(token, this->exprs->table, condition, loop_body);
     return while_stmt;
 }
 
 // Parse an if statement
-std::shared_ptr<Statement>
+Statement*
 Parser::_parse_if_statement() {
-    token_t token = this->current_token;
-    printf("if_stmt: should be eating 'if'\n");
+    token_t token = this->_current();
+    TRACE(TRACE_PARSER, "if_stmt: should be eating 'if'\n");
     this->_next_token(); // eat the 'if'
 
     auto condition = this->_parse_expression_interior();
 
     // PARSE IF STATEMENT BODY //
-    auto consequence = std::make_shared<CodeBlock>();
-    if (this->current_token.type == TOK_LBRACE) {
+    auto consequence = this->arena->make<CodeBlock>(this->arena);
+    if (this->_current().type == TOK_LBRACE) {
         this->_parse_code_block(consequence);
     } else {
-        this->error_handler->new_error(this->current_token.line_num, "Missing |{| when parsing if-statement body");
+        this->error_handler->new_error(this->_current().offset, "Missing |{| when parsing if-statement body");
     }
 
     
     // PARSE ELSE CLAUSE //
-    if (this->current_token.type == TOK_ELSE) {
-        printf("if_stmt: contains else clause\n");
+    if (this->_current().type == TOK_ELSE) {
+        TRACE(TRACE_PARSER, "if_stmt: contains else clause\n");
 
-        token_t else_tok = this->current_token;
-        printf("if_stmt: should be eating 'else'\n");
+        token_t else_tok = this->_current();
+        TRACE(TRACE_PARSER, "if_stmt: should be eating 'else'\n");
         this->_next_token(); // eat the 'else'
 
-        if (this->current_token.type == TOK_IF) {
+        if (this->_current().type == TOK_IF) {
             // else if...
-            printf("if_stmt: matched else if\n");
+            TRACE(TRACE_PARSER, "if_stmt: matched else if\n");
             auto alternative = this->_parse_if_statement();
 
-            auto if_stmt = std::make_shared<Conditional>(token, std::move(consequence), std::move(condition), std::move(alternative));
+            auto if_stmt = this->arena->make<Conditional>(token, consequence, this->exprs->table, condition, alternative);
             return if_stmt;
-        } else if (this->current_token.type == TOK_LBRACE) {
+        } else if (this->_current().type == TOK_LBRACE) {
             // just normal else clause
-            printf("if_stmt: final else clause\n");
-            std::vector <std::shared_ptr<Statement> > else_body;
+            TRACE(TRACE_PARSER, "if_stmt: final else clause\n");
             auto else_block = this->_parse_code_block();
 
-            auto else_condition = std::make_shared<BooleanExpr>(true);
-            auto else_stmt = std::make_shared<Conditional>(else_tok, std::move(else_block), std::move(else_condition), nullptr); 
+            expr_node_t else_condition = expr_node(NODE_BOOLEAN, TYPE_BOOL);
+            else_condition.int_value = true;
+            auto else_stmt = this->arena->make<Conditional>(else_tok, else_block, this->exprs->table, this->exprs->add(else_condition), nullptr); 
             
             
-            auto if_stmt = std::make_shared<Conditional>(token, std::move(consequence), std::move(condition), std::move(else_stmt));
+            auto if_stmt = this->arena->make<Conditional>(token, consequence, this->exprs->table, condition, else_stmt);
             return if_stmt;
         }
     }
 
 
     // No else or else if clauses
-    auto if_stmt = std::make_shared<Conditional>(token, std::move(consequence), std::move(condition), nullptr);
+    auto if_stmt = this->arena->make<Conditional>(token, consequence, this->exprs->table, condition, nullptr);
     return if_stmt;
 }
 
@@ -882,110 +1266,128 @@ Parser::_parse_if_statement() {
 /////////////////////////////////////////////////////////
 
 // Parse an identifier in an expression
-std::shared_ptr<Expression>
+expr_t
 Parser::_parse_identifier() {
-    token_t ident_tok = this->current_token;
-    printf("parse_identifier: should be eating identifier\n");
+    token_t ident_tok = this->_current();
+    TRACE(TRACE_PARSER, "parse_identifier: should be eating identifier\n");
     this->_next_token(); // eat the identifier
 
 
-    if (this->current_token.type != TOK_LPAREN) {
+    if (this->_current().type != TOK_LPAREN) {
         // Normal variable reference not function call
-        auto ident = std::make_shared<IdentifierExpr>();
-        ident->name = ident_tok.literal;
-        ident->data_type = TYPE_VOID;
-        return ident;
+        expr_node_t ident = expr_node(NODE_IDENTIFIER, TYPE_VOID);
+        ident.name = ident_tok.value.symbol;
+        return this->exprs->add(ident);
     }
 
-    printf("parse_ident: should be eating '('\n");
+    TRACE(TRACE_PARSER, "parse_ident: should be eating '('\n");
     this->_next_token();
 
-    std::vector <std::shared_ptr<Expression> > func_args;
-    while (this->current_token.type != TOK_RPAREN) {
-        if (auto arg = this->_parse_expression_interior())
-            func_args.push_back(std::move(arg));
+    // A call that fails to parse drops the arguments it did parse
+    expr_t mark = this->exprs->nodes.size();
+    std::vector <expr_t> func_args;
+    while (this->_current().type != TOK_RPAREN) {
+        expr_t arg = this->_parse_expression_interior();
+        if (arg != EXPR_NONE)
+            func_args.push_back(arg);
         else {
             // function arg invalid
-            printf("parse_ident: error: invalid argument on line %d: '%s'\n", this->current_token.line_num, this->current_token.literal.c_str());
-            return nullptr;
+            char err[100];
+            snprintf(err, sizeof(err), "invalid argument '" SV_FMT "'", SV_ARG(this->_current().literal));
+            this->error_handler->new_error(this->_current().offset, err);
+            this->_synchronize(SYNC_ARGUMENT);
+            if (this->_current().type == TOK_RPAREN)
+                this->_next_token();
+            this->exprs->truncate(mark);
+            return EXPR_NONE;
         }
 
-        if (this->current_token.type == TOK_RPAREN)
+        if (this->_current().type == TOK_RPAREN)
             break;
 
-        if (this->current_token.type != TOK_COMMA) {
-            printf("parse_ident: error: invalid token on line %d '%s'. Expected ','\n", this->current_token.line_num, this->current_token.literal.c_str());
-            return nullptr;
+        if (this->_current().type != TOK_COMMA) {
+            char err[100];
+            snprintf(err, sizeof(err), "invalid token '" SV_FMT "'. Expected ','", SV_ARG(this->_current().literal));
+            this->error_handler->new_error(this->_current().offset, err);
+            this->_synchronize(SYNC_ARGUMENT);
+            if (this->_current().type == TOK_RPAREN)
+                this->_next_token();
+            this->exprs->truncate(mark);
+            return EXPR_NONE;
         }
 
-        printf("parse_ident: should be eating ','\n");
+        TRACE(TRACE_PARSER, "parse_ident: should be eating ','\n");
         this->_next_token();
     }
 
-    printf("parse_ident: should be eating ')'\n");
+    TRACE(TRACE_PARSER, "parse_ident: should be eating ')'\n");
     this->_next_token();
-    auto func_call = std::make_shared<FunctionCallExpr>(ident_tok.literal, std::move(func_args));
-    func_call->data_type = TYPE_VOID;
-    return func_call;
+    expr_node_t func_call = expr_node(NODE_CALL, TYPE_VOID);
+    func_call.name = ident_tok.value.symbol;
+    func_call.children[0] = this->exprs->args.size();
+    func_call.children[1] = func_args.size();
+    this->exprs->args.insert(this->exprs->args.end(), func_args.begin(), func_args.end());
+    return this->exprs->add(func_call);
 }
 
 // Parse parts in an expression
-std::shared_ptr<Expression>
+// The token's prefix rule picks how. A token that cannot start an expression is eaten,
+// unless it is one the expression's statement can go on from.
+expr_t
 Parser::_parse_primary() {
-    char err[100];
-    switch(this->current_token.type) {
-        case TOK_INT:
-            printf("primary matched %s\n", this->current_token.literal.c_str());
-            return this->_parse_integer();
-        case TOK_BYTE:
-            printf("primary matched %s\n", this->current_token.literal.c_str());
-            return this->_parse_byte();
-        case TOK_FLOAT:
-            printf("primary matched %s\n", this->current_token.literal.c_str());
-            return this->_parse_float();
-        case TOK_TRUE:
-            printf("primary matched %s\n", this->current_token.literal.c_str());
-            return this->_parse_boolean();
-        case TOK_FALSE:
-            printf("primary matched %s\n", this->current_token.literal.c_str());
-            return this->_parse_boolean();
-        case TOK_IDENT:
-            printf("primary matched %s\n", this->current_token.literal.c_str());
-            return this->_parse_identifier();
-        case TOK_LPAREN:
-            printf("primary matched %s\n", this->current_token.literal.c_str());
-            return this->_parse_parentheses_expr();
-        default:
-            sprintf(err, "invalid token '%s' when parsing expression", this->current_token.literal.c_str());
-            this->error_handler->new_error(this->current_token.line_num, err);
-            printf("PRIMARY NULL\n");
-            this->_next_token();
-            return nullptr;
+    const parse_rule_t &rule = parse_rules[this->_current().type];
+    if (rule.prefix != nullptr && this->depth < PARSER_MAX_DEPTH) {
+        TRACE(TRACE_PARSER, "primary matched " SV_FMT "\n", SV_ARG(this->_current().literal));
+        this->depth++;
+        expr_t expr = (this->*rule.prefix)();
+        this->depth--;
+        return expr;
+    }
+
+    if (rule.prefix != nullptr) {
+        // Too deeply nested -- give up on the statement
+        this->error_handler->new_error(this->_current().offset, "expression nested too deeply");
+        this->_synchronize(SYNC_STATEMENT);
+        return EXPR_NONE;
     }
+
+    char err[100];
+    snprintf(err, sizeof(err), "invalid token '" SV_FMT "' when parsing expression", SV_ARG(this->_current().literal));
+    this->error_handler->new_error(this->_current().offset, err);
+    TRACE(TRACE_PARSER, "PRIMARY NULL\n");
+    if (!this->_at(SYNC_EXPRESSION))
+        this->_next_token();
+    return EXPR_NONE;
 }
 
 // Parse expressions within parentheses
 // x + (5 * 2)
-std::shared_ptr<Expression>
+expr_t
 Parser::_parse_parentheses_expr() {
-    if (this->current_token.type != TOK_LPAREN) {
-        printf("parse_paren: error -- first token '%s' != ')'\n", this->current_token.literal.c_str());
+    if (this->_current().type != TOK_LPAREN) {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected '('", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
     }
-    printf("parse_paren: should be eating '('\n");
+    TRACE(TRACE_PARSER, "parse_paren: should be eating '('\n");
     this->_next_token(); // eat the '('
 
-    auto expr = this->_parse_expression_interior();
+    expr_t mark = this->exprs->nodes.size();
+    expr_t expr = this->_parse_expression_interior();
 
-    if (!expr) {
-        printf("parse_paren: null\n");
-        return nullptr;
+    if (expr == EXPR_NONE) {
+        TRACE(TRACE_PARSER, "parse_paren: null\n");
+        return EXPR_NONE;
     }
 
-    if (this->current_token.type != TOK_RPAREN) {
-        printf("parse_paren: expected ')' got '%s'\n", this->current_token.literal.c_str());
-        return nullptr;
+    if (this->_current().type != TOK_RPAREN) {
+        char err[100];
+        snprintf(err, sizeof(err), "unexpected token '" SV_FMT "'. Expected ')'", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+        this->exprs->truncate(mark);
+        return EXPR_NONE;
     } else {
-        printf("parse_paren: matched ')'\n");
+        TRACE(TRACE_PARSER, "parse_paren: matched ')'\n");
         this->_next_token(); // eat the ')'
     }
 
@@ -993,30 +1395,34 @@ Parser::_parse_parentheses_expr() {
 }
 
 // Parses expressions that are not top level
-std::shared_ptr<Expression>
+// Tokens that cannot start an expression are skipped up to the first that can -- EXPR_NONE
+// if the expression ends before one turns up
+expr_t
 Parser::_parse_expression_interior() {
-    auto LHS = this->_parse_primary();
+    expr_t LHS = this->_parse_primary();
 
-    while (!LHS) {
-        printf("parse_expr_interior: LHS null\n");
+    while (LHS == EXPR_NONE) {
+        TRACE(TRACE_PARSER, "parse_expr_interior: LHS null\n");
+        if (this->_at(SYNC_EXPRESSION))
+            return EXPR_NONE;
         LHS = this->_parse_primary();
     }
 
-    LHS = this->_parse_expr(0, std::move(LHS));
+    LHS = this->_parse_expr(0, LHS);
     
     return LHS;
 }
 
 // Parses the expression statement wrapper
-std::shared_ptr<Statement>
+Statement*
 Parser::_parse_expression_statement() {
-    auto LHS = this->_parse_primary();
-    LHS = this->_parse_expr(0, std::move(LHS));
+    expr_t LHS = this->_parse_primary();
+    LHS = this->_parse_expr(0, LHS);
 
-    auto stmt = std::make_shared<ExpressionStatement>(this->current_token, std::move(LHS));
+    auto stmt = this->arena->make<ExpressionStatement>(this->_current(), this->exprs->table, LHS);
 
-    if (this->current_token.type == TOK_SEMICOLON) {
-        printf("parse_expr_stmt: should be eating ';'\n");
+    if (this->_current().type == TOK_SEMICOLON) {
+        TRACE(TRACE_PARSER, "parse_expr_stmt: should be eating ';'\n");
         this->_next_token();
     }
 
@@ -1027,152 +1433,156 @@ Parser::_parse_expression_statement() {
 // if it is not a valid operator it returns -1
 int
 Parser::_get_token_precedence() {
-    int tok_prec = this->operator_precedences[this->current_token.type];
+    int tok_prec = parse_rules[this->_current().type].power;
     if (tok_prec <= 0) 
         return -1;
 
     return tok_prec;
 }
 
-// Parse expression until we reach a semicolon
-std::shared_ptr<Expression>
-Parser::_parse_expr(int precedence, std::shared_ptr<Expression> LHS) {
+// Parse the rest of an expression whose first operand is LHS
+// Pratt parsing: every operator binding at least as tightly as 'precedence' is folded into
+// LHS by its infix rule, which parses its own right hand side. A run of operators of the
+// same power is folded in this loop, so "a + b + c + ..." never recurses.
+expr_t
+Parser::_parse_expr(int precedence, expr_t LHS) {
     while (1) {
-        if (this->current_token.type == TOK_SEMICOLON || this->current_token.type == TOK_RPAREN) {
-            if (this->current_token.type == TOK_SEMICOLON) printf("semicolon 1\n");
-            else printf("rparen1\n");
+        const parse_rule_t &rule = parse_rules[this->_current().type];
+        if (rule.infix == nullptr || rule.power < precedence)
             return LHS;
-        }
 
-        int prec = this->_get_token_precedence();
-        if (prec < precedence) {
-            printf("prec1 '%s' = %d\n", this->current_token.literal.c_str(), prec);
-            return LHS;
-        }
-        printf("prec: '%s' %d\n", this->current_token.literal.c_str(), prec);
-
-        token_t op = this->current_token;
-        printf("op %s\n", op.literal.c_str());
-
-        if (prec < 0) {
-            printf("parse_expr: invalid operator '%s'\n", op.literal.c_str());
-            return LHS;
-        }
-        printf("parse_expr: should be eating operator\n");
-        this->_next_token();
-
-        // Check if there is an early end to an expression
-        if (this->current_token.type == TOK_SEMICOLON || this->current_token.type == TOK_RPAREN) {
-            char err[100];
-            sprintf(err, "premature '%s' in expression", this->current_token.literal.c_str());
-            this->error_handler->new_error(this->current_token.line_num, err);
-            return LHS;
-        }
-    
-        auto RHS = this->_parse_primary();
-        while (!RHS) {
-            printf("parse_expr: RHS null.\nShould be eating invalid token\n");
-            if (this->current_token.type == TOK_RPAREN || this->current_token.type == TOK_SEMICOLON) {
-                break;
-            }
-            RHS = this->_parse_primary();
-        }
-
-        if (this->current_token.type == TOK_SEMICOLON || this->current_token.type == TOK_RPAREN) {
-            if (this->current_token.type == TOK_SEMICOLON) printf("semicolon 2\n");
-            else printf("rparen2\n");
- 
-            LHS = std::make_shared<BinaryExpr>(op, std::move(LHS), std::move(RHS));
-            return LHS;
-        }
+        LHS = (this->*rule.infix)(LHS);
+    }
+}
 
-        int next_prec = this->_get_token_precedence();
-        if (next_prec < 1) {
-            printf("invalid operator '%s'\n", this->current_token.literal.c_str());
-            return std::make_shared<BinaryExpr>(op, std::move(LHS), std::move(RHS));
-        }
+// Parse an infix (binary) operator and its right hand side -- "a + b"
+// The right hand side takes every operator binding tighter than this one, or as tight
+// for a right associative operator
+expr_t
+Parser::_parse_infix_op(expr_t LHS) {
+    token_t op = this->_current();
+    const parse_rule_t &rule = parse_rules[op.type];
+    TRACE(TRACE_PARSER, "parse_expr: should be eating operator\n");
+    this->_next_token();
 
-        printf("next prec: '%s' %d\n", this->current_token.literal.c_str(), next_prec);
-        if (prec < next_prec) {
-            printf("prec < next_prec\n");
-            RHS = this->_parse_expr(prec+1, std::move(RHS));
-            if (!RHS) {
-                printf("rhs null\n");
-                return nullptr;
-            }
-        }
+    // Check if there is an early end to an expression
+    if (this->_at(SYNC_EXPRESSION)) {
+        char err[100];
+        sprintf(err, "premature '" SV_FMT "' in expression", SV_ARG(this->_current().literal));
+        this->error_handler->new_error(this->_current().offset, err);
+        return LHS;
+    }
 
-        LHS = std::make_shared<BinaryExpr>(op, std::move(LHS), std::move(RHS));
+    expr_t RHS = this->_parse_primary();
+    while (RHS == EXPR_NONE) {
+        TRACE(TRACE_PARSER, "parse_expr: RHS null.\nShould be eating invalid token\n");
+        if (this->_at(SYNC_EXPRESSION))
+            break;
+        RHS = this->_parse_primary();
     }
 
-    return std::make_shared<Expression>();
+    if (RHS != EXPR_NONE)
+        RHS = this->_parse_expr(rule.assoc == ASSOC_LEFT ? rule.power + 1 : rule.power, RHS);
+
+    expr_node_t binary = expr_node(NODE_BINARY, TYPE_VOID);
+    binary.op = op.type;
+    binary.children[0] = LHS;
+    binary.children[1] = RHS;
+    return this->exprs->add(binary);
 }
 
 // parse the program
 // start at top level and cascade down the tree
-std::shared_ptr<Program>
+Program*
 Parser::_parse_program() {
-    this->program = std::make_shared<Program>();
+    this->program = this->arena->make<Program>(this->arena);
     this->program->parent = nullptr;
+    this->_begin_exprs(&this->global_exprs);
+    this->program->exprs = this->exprs->table;
+
+    // With every token already lexed, the functions can be found up front. Those the cache
+    // remembers are spliced in and the rest are parsed on the pool, if there is one. The
+    // loop below picks them up in source order.
+    bool parallel = this->pool != nullptr && this->pool->size() > 1;
+    if (this->token_stream.buffer != nullptr && (this->cache != nullptr || parallel)) {
+        this->function_spans = this->_find_functions();
+        this->parsed_functions.assign(this->function_spans.size(), nullptr);
+        if (this->cache != nullptr)
+            this->_reuse_functions();
+        if (parallel)
+            this->_parse_functions_parallel();
+    } else if (this->cache != nullptr) {
+        this->cache->reused = 0;
+    }
 
     // main loop
-    while (this->current_token.type != TOK_EOF) {
-        std::shared_ptr<Statement> stmt;
-        std::shared_ptr<SymbolTableEntry> symbol_table_entry;
-        switch(this->current_token.type) {
+    std::vector <Statement*> statements;
+    while (this->_current().type != TOK_EOF) {
+        Statement* stmt;
+        SymbolTableEntry* symbol_table_entry;
+        size_t eaten = this->tokens_eaten;
+        switch(this->_current().type) {
             case TOK_LET: // Top-level variable declarations;
-                printf("matched let\n");
+                TRACE(TRACE_PARSER, "matched let\n");
                 stmt = this->_parse_let_statement();
+                if (stmt == nullptr)
+                    break;
 
                 // Check if variable has been declared already -- CLEAN UP -- ACTUALLY MAKE THIS ERROR
-                if (symbol_table->find(dynamic_cast<VariableExpr*>(dynamic_cast<LetStmt*>(stmt.get())->variable.get())->name) == true) {
-                    std::string name = dynamic_cast<VariableExpr*>(dynamic_cast<LetStmt*>(stmt.get())->variable.get())->name;
+                if (symbol_table->find(cast<LetStmt>(stmt)->name) == true) {
+                    symbol_t name = cast<LetStmt>(stmt)->name;
                     char buf[200];
-                    sprintf(buf, "parse_program: error: redeclaration of |%s| in this scope", name.c_str());
-                    this->error_handler->new_error(dynamic_cast<LetStmt*>(stmt.get())->token.line_num, buf);
+                    sprintf(buf, "parse_program: error: redeclaration of |%s| in this scope", symbol_name(name).c_str());
+                    this->error_handler->new_error(cast<LetStmt>(stmt)->token.offset, buf);
                     break;
                 }
 
-                symbol_table_entry = dynamic_cast<LetStmt*>(stmt.get())->_get_st_entry();
-                program->symbol_table->add(std::move(symbol_table_entry));
-                program->statements.push_back(std::move(stmt));
+                symbol_table_entry = cast<LetStmt>(stmt)->_get_st_entry(this->arena);
+                program->symbol_table.add(symbol_table_entry);
+                statements.push_back(stmt);
 
                 break;
             
             case TOK_FUNCTION: // Top-level function definitions
-                printf("matched function\n");
+                TRACE(TRACE_PARSER, "matched function\n");
 
-                stmt = this->_parse_function_defn();
-                symbol_table_entry = dynamic_cast<FunctionDecl*>(stmt.get())->_get_st_entry();
-                program->symbol_table->add(std::move(symbol_table_entry));
-                this->program->statements.push_back(std::move(stmt));
+                stmt = this->_parse_top_level_function();
+                symbol_table_entry = cast<FunctionDecl>(stmt)->_get_st_entry(this->arena);
+                program->symbol_table.add(symbol_table_entry);
+                statements.push_back(stmt);
                 break;
             
             case TOK_ENTRY: // Top-level function definition, but entry point to the program
-                printf("matched entry\n");
-                stmt = this->_parse_function_defn();
-                symbol_table_entry = dynamic_cast<FunctionDecl*>(stmt.get())->_get_st_entry();
-                program->symbol_table->add(std::move(symbol_table_entry));
-                this->program->statements.push_back(std::move(stmt));
+                TRACE(TRACE_PARSER, "matched entry\n");
+                stmt = this->_parse_top_level_function();
+                symbol_table_entry = cast<FunctionDecl>(stmt)->_get_st_entry(this->arena);
+                program->symbol_table.add(symbol_table_entry);
+                statements.push_back(stmt);
                 break;
             
             case TOK_EOF: // End of the program
                 // low key shouldn't ever reach this unless I fucked up the parsing
-                printf("parse_program: TOK_EOF in switch ending program\n");
+                TRACE(TRACE_PARSER, "parse_program: TOK_EOF in switch ending program\n");
                 break;
             
-            default:
-                // Assume it is an expression statement
+            default: {
+                // Assume it is an expression statement -- it is thrown away, its expressions too
+                expr_t mark = this->exprs->nodes.size();
                 this->_parse_expression_statement();
+                this->exprs->truncate(mark);
                 break;
+            }
         }
+
+        // A token no statement can start with is skipped, so every pass eats at least one
+        if (this->tokens_eaten == eaten)
+            this->_next_token();
     }
     // endloop:
-
-    printf(" -- Program --\n");
-
-    this->program->_print();
-    this->program->symbol_table->print_elements();
+    this->program->statements = this->arena->list(statements);
+    this->_finish_exprs();
+    if (this->cache != nullptr)
+        this->_remember_functions();
 
     this->program->assign_parents(); // assign all the parents in the AST
 
@@ -1180,10 +1590,10 @@ Parser::_parse_program() {
 }
 
 // Parse the program and create the abstract syntax tree
-std::shared_ptr<AST>
+AST*
 Parser::_create_ast() {
     auto program = this->_parse_program();
-    std::shared_ptr<AST> ast = std::make_shared<AST>();
+    AST* ast = this->arena->make<AST>();
     ast->program_node = program;
 
     return ast;
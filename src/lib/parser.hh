@@ -10,60 +10,126 @@
 #define PARSER_
 
 #include "lexer.hh"
+#include "tokenbuffer.hh"
+#include "tokenstream.hh"
 #include "ast.hh"
 #include "errorhandler.hh"
+#include "threadpool.hh"
+#include "parsecache.hh"
 #include <string>
-#include <map>
+#include <vector>
+
+// Tokens of a top-level function definition, found before it is parsed
+// 'begin' is the index of its 'define' or 'entry' keyword, 'end' is just past its closing '}'
+struct function_span_t {
+    size_t begin;
+    size_t end;
+};
+
+// Deepest the parser nests code blocks or expressions -- anything deeper is an error
+// Parsing recurses, so this keeps garbage like a long run of '(' from running it out of stack
+#define PARSER_MAX_DEPTH 1024
+
+// Expressions of the function being parsed, or of the top level of the program
+// Nodes are added as they are parsed, which puts them in post-order. The table only gets
+// them once the function ends, copied into the arena in one piece -- see ExprTable.
+typedef struct ExprBuilder {
+    ExprTable *table = nullptr;             // table the statements point at -- DO NOT FREE
+    std::vector <expr_node_t> nodes;
+    std::vector <expr_t> args;
+
+    expr_t add(const expr_node_t &node) {
+        this->nodes.push_back(node);
+        return (expr_t)(this->nodes.size() - 1);
+    }
+
+    // Drop the nodes from mark on -- expressions that were parsed and then thrown away
+    // The calls among them are the last to have added arguments
+    void truncate(expr_t mark) {
+        this->nodes.resize(mark);
+        while (!this->args.empty() && this->args.back() >= mark)
+            this->args.pop_back();
+    }
+} expr_builder_t;
+
+// Set of token types -- bit t is set if token type t is in the set
+// The parser skips to a token in one of these after a syntax error, see _synchronize
+typedef uint64_t token_set_t;
 
 // Parser class
 // Parses the token stream and generates
 // the Abstract Syntax Tree
 class Parser {
 public:
-    Parser(std::vector<token_t> token_stream);    // constructor -- uses string parameter to initialize a lexer
+    Parser(Lexer *lexer);                          // constructor -- pulls tokens from the lexer on demand
+    Parser(const TokenBuffer &token_buffer);       // constructor -- reads an already filled token buffer
+    Parser(const TokenBuffer &token_buffer, size_t begin, size_t end); // constructor -- reads the tokens in [begin, end) of a filled buffer
     ~Parser();                                                                    // destructor -- deletes the lexer that it created
 
     ErrorHandler *error_handler;                     // error hander given to the parser by the compiler -- DO NOT FREE: THIS SHOULD BE GIVEN BACK TO THE COMPILER WHEN WE ARE DONE
     SymbolTable *symbol_table;                         // symbol table given to the parser by the compiler -- DO NOT FREE: THIS SHOULD BE GIVEN BACK TO THE COMPILER WHEN WE ARE DONE
+    Arena *arena;                                                 // arena the AST is made in, given to the parser by the compiler -- DO NOT FREE
+    ParseCache *cache;                                            // functions of the last parse of this source, given by the compiler -- nullptr parses everything. DO NOT FREE
+    ThreadPool *pool;                                             // pool top-level functions are parsed on, given by the compiler -- nullptr parses everything on this thread. DO NOT FREE
     bool has_entry;                                                // true if there is an entry point false otherwise
-    std::vector <token_t> token_stream;        // token stream to parse
-    size_t current_position;                             // the current position we are at in the token stream
-    std::shared_ptr<Program> program;            // the program node of the parser -- root node of the AST
+    TokenStream token_stream;                  // token stream to parse
+    Program* program;            // the program node of the parser -- root node of the AST
+    std::vector <function_span_t> function_spans;  // top-level functions found before parsing
+    std::vector <FunctionDecl*> parsed_functions;   // the function of each span once it is parsed cleanly or reused -- nullptr otherwise
+    std::vector <uint64_t> function_fingerprints;   // fingerprint of each span's tokens -- only with a cache
+    size_t next_parsed_function;                    // index in parsed_functions of the next one the program reaches
+    size_t tokens_eaten;                            // tokens consumed so far -- lets a loop check that it made progress
+    size_t depth;                                   // code blocks and expressions the parser is inside of
+    expr_builder_t global_exprs;                    // expressions of the top-level statements
+    expr_builder_t function_exprs;                  // expressions of the function being parsed
+    expr_builder_t *exprs;                          // whichever of the two the parser is adding to
 
 
     /// METHODS ///
-    void _next_token();                                 // eats current token and advances the peek and current tokens
-    std::shared_ptr<AST> _create_ast(); // create the abstract syntax tree
+    void _init();                                       // sets up the state shared by the constructors
+    void _next_token();                                 // eats the current token
+    const token_t &_current() { return this->token_stream.peek(0); }        // the token the parser is 'looking at'
+    const token_t &_peek(size_t k) { return this->token_stream.peek(k); }   // the token k after the current one -- k < TOKEN_LOOKAHEAD
+    size_t _token_index();                              // index in the token buffer of the current token
+    void _seek(size_t position);                        // make the token at a buffer index the current token
+    symbol_t _symbol(const token_t &tok);               // interned name of a token -- identifiers already carry theirs
+    bool _at(token_set_t set) { return (set >> this->_current().type) & 1; } // true if the current token is in the set
+    void _synchronize(token_set_t sync);                // skip to the first token in sync -- panic mode error recovery
+    void _skip_statement();                             // skip the rest of a statement that could not be parsed
+    void _begin_exprs(expr_builder_t *builder);         // start a new table and add expressions to it
+    void _finish_exprs();                               // copy the expressions added into their table
+    AST* _create_ast(); // create the abstract syntax tree
     int _get_token_precedence();                // gets the precedence for the current token
 
 
     // Parsing functions
-    std::shared_ptr<Program> _parse_program();                                                 // parse the top level program
-    std::shared_ptr<Statement> _parse_code_block();                                        // parse a block of code
-    std::shared_ptr<Statement> _parse_let_statement();                                 // parse let statements
-    std::shared_ptr<Statement> _parse_return_statement();                            // parse return statements
-    std::shared_ptr<Statement> _parse_if_statement();                                    // parse if statements
-    std::shared_ptr<Statement> _parse_while_statement();                             // parse while loop statements
-    std::shared_ptr<Statement> _parse_for_statement();                                 // parse for loop statements
-    std::shared_ptr<Statement> _parse_function_defn();                                 // parse function prototypes
-    std::shared_ptr<Expression> _parse_integer();                                            // parse an integer literal
-    std::shared_ptr<Expression> _parse_byte();                                                 // parse an byte literal
-    std::shared_ptr<Expression> _parse_float();                                                // parse floating point literal
-    std::shared_ptr<Expression> _parse_identifier();                                     // parse an identifier expression
-    std::shared_ptr<Expression> _parse_boolean();                                            // parse a boolean literal
-    std::shared_ptr<Statement> _parse_expression_statement();                    // parse expression statement wrapper
-    std::shared_ptr<Expression> _parse_parentheses_expr();                         // parse expressions contained within parentheses
-    std::shared_ptr<Statement> _parse_code_block(std::shared_ptr<CodeBlock> scope);                     // parse a block of code
-    std::shared_ptr<Expression> _parse_expr(int precedence, std::shared_ptr<Expression> LHS); // parse expressions
+    Program* _parse_program();                                                 // parse the top level program
+    Statement* _parse_code_block();                                        // parse a block of code
+    Statement* _parse_let_statement();                                 // parse let statements
+    Statement* _parse_return_statement();                            // parse return statements
+    Statement* _parse_if_statement();                                    // parse if statements
+    Statement* _parse_while_statement();                             // parse while loop statements
+    Statement* _parse_for_statement();                                 // parse for loop statements
+    Statement* _parse_function_defn();                                 // parse function prototypes
+    Statement* _parse_top_level_function();                            // parse a top-level function, or take it from parsed_functions
+    std::vector <function_span_t> _find_functions();                   // pre-scan the token buffer for top-level functions
+    void _parse_functions_parallel();                                  // parse the functions in function_spans on the pool
+    void _reuse_functions();                                           // splice in the functions the cache remembers
+    void _remember_functions();                                        // have the cache remember the functions parsed cleanly
+    expr_t _parse_integer();                                            // parse an integer literal
+    expr_t _parse_byte();                                                 // parse an byte literal
+    expr_t _parse_float();                                                // parse floating point literal
+    expr_t _parse_identifier();                                     // parse an identifier expression
+    expr_t _parse_boolean();                                            // parse a boolean literal
+    Statement* _parse_expression_statement();                    // parse expression statement wrapper
+    expr_t _parse_parentheses_expr();                         // parse expressions contained within parentheses
+    Statement* _parse_code_block(CodeBlock* scope);                     // parse a block of code
+    expr_t _parse_expr(int precedence, expr_t LHS); // parse expressions
                                                                                                                                         
-    std::shared_ptr<Expression> _parse_prefix_op();                                                             // parse a prefix (unary) operator "!a"
-    std::shared_ptr<Expression> _parse_infix_op(std::unique_ptr<Expression> rhs); // parse an infix (binary) operator -- "a + b"
-    std::shared_ptr<Expression> _parse_primary();                                                                 // parse members of an expression
-    std::shared_ptr<Expression> _parse_expression_interior();                                         // parses expression that are not top level
-
-    token_t current_token;                                        // the current token that the parser is 'looking at'
-    token_t peek_token;                                             // the next token that the parser would be looking at
-    std::map <int, int> operator_precedences; // map of the operators and their precedences
+    expr_t _parse_prefix_op();                                                             // parse a prefix (unary) operator "!a"
+    expr_t _parse_infix_op(expr_t LHS); // parse an infix (binary) operator -- "a + b"
+    expr_t _parse_primary();                                                                 // parse members of an expression
+    expr_t _parse_expression_interior();                                         // parses expression that are not top level
 };
 
 #endif /* PARSER_ */
@@ -1,122 +1,153 @@
 #include "preprocessor.hh"
+#include "scan.hh"
+#include "trace.hh"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
 #include <cctype>
+#include <cstring>
 #include <string>
 
-Preprocessor::Preprocessor(std::string input) {
-    this->read_position = 0;
-    this->position = 0;
-    this->input = input;
+Preprocessor::Preprocessor(SourceBuffer *source) {
+    this->input = source->text();
 
-    this->directives["$alia"] = DIR_ALIAS;
+    // $include names are relative to the directory of the file they are in,
+    // and a file that includes itself includes nothing
+    size_t slash = source->path.rfind('/');
+    if (slash != std::string::npos)
+        this->directory = source->path.substr(0, slash + 1);
+    char resolved[PATH_MAX];
+    if (!source->path.empty() && realpath(source->path.c_str(), resolved) != nullptr)
+        this->included.insert(resolved);
 
-    this->advance_char();
-    this->advance_char();
+    this->directives["$alias"] = DIR_ALIAS;
+    this->directives["$include"] = DIR_INCLUDE;
+    this->directives["$define"] = DIR_DEFINE;
+    this->directives["$if"] = DIR_IF;
+    this->directives["$else"] = DIR_ELSE;
+    this->directives["$end"] = DIR_END;
+    this->alias_generation = 1;
+    this->alias_cycles = 0;
 }
 
-// Go through the entire source file and transform it where necessary
-// 
-// COMMENTS: "//" character to the end of the line
-std::string
+// Build the preprocessed source in 'output' -- the source without its comments, directives
+// and disabled regions
+// The compiler does not need this, the lexer skips comments and reads directives itself.
+// It is for looking at what the lexer sees.
+// Only the '/' and '$' characters are looked at one by one, everything between them is found
+// with memchr and copied in bulk. Every comment is replaced by a single space so the tokens on
+// either side of it stay apart. 'offset_map' records where each copied span came from.
+std::string_view
 Preprocessor::process() {
-    while (this->cur_char != '\0') {
-        switch (this->cur_char) {
-            case '/':
-                if (this->peek_char() == '/') {
-                    // single line comment
-                    printf("SINGLE LINE COMMENT\n");
-                    this->single_line_comment();
-                } else if (this->peek_char() == '*') {
-                    // multi-line comment
-                    printf("MULTI_LINE_COMMENT\n");
-                    this->multi_line_comment();
-                }
-                break;
-            case '$':
-                // DIRECTIVES
-                if (this->read_directive() == DIR_ALIAS) {
-                    printf("GOT ALIAS\n");
-                }
-                break;
-            default:
-                break;
-        }
+    const char *data = this->input.data();
+    size_t length = this->input.length();
 
-        this->advance_char();
-    }
+    this->output.clear();
+    this->output.reserve(length);
+    this->offset_map.clear();
+    this->conditions.clear();
 
-    return this->input;
-}
+    size_t span = 0;    // start of the span of code not copied yet
+    size_t pos = 0;     // where to look for the next comment or directive
+    const char *dollar = (const char*)memchr(data, '$', length);
+    while (pos < length) {
+        const char *slash = (const char*)memchr(data + pos, '/', length - pos);
+        if (dollar != nullptr && dollar < data + pos)
+            dollar = (const char*)memchr(data + pos, '$', length - pos);
 
-void
-Preprocessor::advance_char() {
-    if (this->read_position >= this->input.length()) {
-        this->cur_char = '\0';
-    } else {
-        this->cur_char = this->input[this->read_position];
-    }
+        const char *next = slash;
+        if (next == nullptr || (dollar != nullptr && dollar < next))
+            next = dollar;
+        if (next == nullptr)
+            break;
 
-    this->position = this->read_position;
-    this->read_position++;
-    return;
-}
+        size_t start = next - data;
+        size_t stop;
+        if (*next == '$') {
+            stop = start;
+            directive_e directive = this->read_directive(this->input, stop);
+            if (directive == DIR_ALIAS) {
+                // the definition is the rest of the line
+                const char *newline = (const char*)memchr(data + stop, '\n', length - stop);
+                stop = (newline == nullptr) ? length : newline - data;
+            } else if (directive == DIR_INCLUDE) {
+                // drop the quoted file name too
+                size_t name = stop;
+                while (name < length && (data[name] == ' ' || data[name] == '\t'))
+                    name++;
+                const char *newline = (const char*)memchr(data + name, '\n', length - name);
+                const char *close = (name < length && data[name] == '"') ? (const char*)memchr(data + name + 1, '"', (newline == nullptr ? length : newline - data) - name - 1) : nullptr;
+                if (close != nullptr)
+                    stop = close - data + 1;
+            } else if (directive == DIR_DEFINE) {
+                this->define(this->read_name(this->input, stop));
+            } else if (directive == DIR_IF) {
+                std::string_view name = this->read_name(this->input, stop);
+                if (!name.empty() && !this->open_condition(name, (uint32_t)start))
+                    stop = this->skip_disabled(this->input, stop);
+            } else if (directive == DIR_ELSE) {
+                if (this->flip_condition() == ELSE_DISABLED)
+                    stop = this->skip_disabled(this->input, stop);
+            } else if (directive == DIR_END) {
+                this->close_condition();
+            }
+        } else if (start + 1 < length && data[start + 1] == '/') {
+            const char *newline = (const char*)memchr(data + start, '\n', length - start);
+            stop = (newline == nullptr) ? length : newline - data;
+        } else if (start + 1 < length && data[start + 1] == '*') {
+            const char *close = find_comment_end(data + start + 2, data + length);
+            stop = (close == data + length) ? length : close - data + 2;
+        } else {
+            // a '/' that divides
+            pos = start + 1;
+            continue;
+        }
 
-char
-Preprocessor::peek_char() {
-    if ((size_t)this->read_position >= this->input.length()) {
-        return '\0';
-    } else {
-        return this->input[this->read_position];
+        this->copy_span(span, start);
+        if (*next == '/')
+            this->output.push_back(' ');
+        span = stop;
+        pos = stop;
     }
+
+    this->copy_span(span, length);
+    return this->output;
 }
 
-// Read a single line comment
-// replace each character with a ' ' until the end of the line
+// Append input[from, to) to the output and remember where it came from
 void
-Preprocessor::single_line_comment() {
-    while (this->cur_char != '\n') {
-        printf("replacing [%c]\n", this->input[position]);
-        this->input[this->position] = ' ';
-        this->advance_char();
-    }
+Preprocessor::copy_span(size_t from, size_t to) {
+    if (from >= to)
+        return;
+
+    this->offset_map.push_back(offset_map_entry_t{(uint32_t)this->output.size(), (uint32_t)from});
+    this->output.append(this->input.data() + from, to - from);
 }
 
-// Read a multi-line comment
-// replace each character with a ' ' until "*/" is read
-void
-Preprocessor::multi_line_comment() {
-    while (1) {
-        if (this->cur_char == '*') {
-            if (this->peek_char() == '/') {
-                // read "*/" -- end of comment
-                printf("expected: [/]. Replacing [%c]\n", this->input[this->position]);
-                this->input[this->position] = ' ';
-                this->advance_char();
-                printf("expected: [/]. Replacing [%c]\n", this->input[this->position]);
-                this->input[this->position] = ' ';
-                this->advance_char();
-                break;
-            }
-        }
-        printf("Replacing [%c]\n", this->input[this->position]);
-        this->input[this->position] = ' ';
-        this->advance_char();
-    }
+// Map an offset in the output of process() back to the source
+// The space that replaces a comment maps to the start of the comment
+size_t
+Preprocessor::source_offset(size_t output_offset) const {
+    auto it = std::upper_bound(this->offset_map.begin(), this->offset_map.end(), output_offset,
+        [](size_t offset, const offset_map_entry_t &entry) { return offset < entry.output_offset; });
+    if (it == this->offset_map.begin())
+        return output_offset;
+
+    --it;
+    return it->source_offset + (output_offset - it->output_offset);
 }
 
+// Read the directive whose '$' is at text[position]
+// position is moved past the directive's name. The lexer calls this directly while it scans,
+// so directives are handled in the same pass that reads the tokens
 directive_e
-Preprocessor::read_directive() {
-    printf("read_directive: replacing [%c]\n", this->input[position]);
-    this->input[position] = ' ';
-    this->advance_char(); // eat the '$'
-    std::string dir_string = "$";
-    while (isalpha(this->cur_char) != 0) {
-        dir_string.push_back(this->cur_char);
-        printf("curchar: [%c] -- read_directive: replacing [%c]\n", this->cur_char, this->input[position]);
-        this->input[position] = ' ';
-        this->advance_char();
-    }
+Preprocessor::read_directive(std::string_view text, size_t &position) {
+    size_t start = position;
+    position++; // eat the '$'
+    while (position < text.length() && isalpha((unsigned char)text[position]) != 0)
+        position++;
 
-    printf("FINAL DIRECTIVE: %s\n", dir_string.c_str());
+    std::string dir_string(text.substr(start, position - start));
     if (this->check_directive(dir_string)) {
         // valid directive
         return this->directives[dir_string];
@@ -134,3 +165,159 @@ Preprocessor::check_directive(std::string directive) {
         return false;
     }
 }
+
+// Define an alias, replacing any earlier alias with the same name
+void
+Preprocessor::define_alias(symbol_t name, std::vector <token_t> replacement) {
+    alias_t &alias = this->aliases[name];
+    alias.replacement = std::move(replacement);
+    alias.expansion.clear();
+
+    // any memoized expansion could have used the old definition
+    this->alias_generation++;
+    TRACE(TRACE_PREPROCESSOR, "$alias %s: %zu tokens", symbol_name(name).c_str(), alias.replacement.size());
+}
+
+// Resolve the file name of an $include against the directory of the source
+std::string
+Preprocessor::include_path(std::string_view name) const {
+    if (!name.empty() && name[0] == '/')
+        return std::string(name);
+    return this->directory + std::string(name);
+}
+
+// Read the name after a directive at text[position] and move past it
+// Spaces and tabs before the name are skipped, it has to start with a letter
+std::string_view
+Preprocessor::read_name(std::string_view text, size_t &position) const {
+    size_t start = position;
+    while (start < text.length() && (text[start] == ' ' || text[start] == '\t'))
+        start++;
+    if (start >= text.length() || isalpha((unsigned char)text[start]) == 0)
+        return std::string_view();
+
+    size_t end = start + scan_identifier(text.data() + start, text.data() + text.length());
+    position = end;
+    return text.substr(start, end - start);
+}
+
+// $define -- names stay defined for the rest of the source
+void
+Preprocessor::define(std::string_view name) {
+    if (!name.empty())
+        this->defines.insert(intern(name));
+    TRACE(TRACE_PREPROCESSOR, "$define %.*s", (int)name.length(), name.data());
+}
+
+// $if -- the region up to the matching $else or $end is enabled if the name is defined
+bool
+Preprocessor::open_condition(std::string_view name, uint32_t offset) {
+    bool enabled = this->defines.count(intern(name)) != 0;
+    this->conditions.push_back(condition_t{offset, enabled, false});
+    TRACE(TRACE_PREPROCESSOR, "$if %.*s: %s", (int)name.length(), name.data(), enabled ? "enabled" : "disabled");
+    return enabled;
+}
+
+// $else -- the region up to the matching $end is enabled if the one before was not
+else_result_e
+Preprocessor::flip_condition() {
+    if (this->conditions.empty() || this->conditions.back().seen_else)
+        return ELSE_UNMATCHED;
+
+    condition_t &cond = this->conditions.back();
+    cond.seen_else = true;
+    cond.enabled = !cond.enabled;
+    return cond.enabled ? ELSE_ENABLED : ELSE_DISABLED;
+}
+
+// $end
+bool
+Preprocessor::close_condition() {
+    if (this->conditions.empty())
+        return false;
+
+    this->conditions.pop_back();
+    return true;
+}
+
+// Find the end of the disabled region starting at text[position]
+// The region is not tokenized or copied, only searched with memchr for a '$' that
+// starts a line -- after any indentation. Nested $if ... $end pairs are counted so the
+// region ends at the $else or $end belonging to its own $if. A region that is never
+// closed runs to the end of the text.
+size_t
+Preprocessor::skip_disabled(std::string_view text, size_t position) {
+    const char *data = text.data();
+    size_t length = text.length();
+    size_t depth = 0;
+    size_t start = position;
+
+    while (position < length) {
+        const char *dollar = (const char*)memchr(data + position, '$', length - position);
+        if (dollar == nullptr)
+            break;
+
+        size_t at = dollar - data;
+        position = at + 1;
+
+        size_t line = at;
+        while (line > 0 && (data[line - 1] == ' ' || data[line - 1] == '\t'))
+            line--;
+        if (line > 0 && data[line - 1] != '\n')
+            continue;
+
+        size_t end = at;
+        directive_e directive = this->read_directive(text, end);
+        if (directive == DIR_IF) {
+            depth++;
+        } else if (directive == DIR_END) {
+            if (depth == 0) {
+                TRACE(TRACE_PREPROCESSOR, "skipped %zu disabled bytes", at - start);
+                return at;
+            }
+            depth--;
+        } else if (directive == DIR_ELSE && depth == 0) {
+            TRACE(TRACE_PREPROCESSOR, "skipped %zu disabled bytes", at - start);
+            return at;
+        }
+    }
+
+    TRACE(TRACE_PREPROCESSOR, "skipped %zu disabled bytes to the end", length - start);
+    return length;
+}
+
+// Get the tokens an alias expands to
+// The expansion is worked out the first time it is asked for and then reused, so expanding
+// an alias costs one hash lookup plus copying its tokens. An alias found inside its own
+// expansion is left as a plain identifier, and an expansion cut short like that is not
+// memoized, since it depends on what was being expanded at the time.
+const std::vector <token_t>*
+Preprocessor::expand_alias(symbol_t name) {
+    auto it = this->aliases.find(name);
+    if (it == this->aliases.end())
+        return nullptr;
+
+    alias_t &alias = it->second;
+    if (alias.expanding) {
+        this->alias_cycles++;
+        return nullptr;
+    }
+    if (alias.generation == this->alias_generation)
+        return &alias.expansion;
+
+    size_t cycles = this->alias_cycles;
+    std::vector <token_t> expansion;
+    alias.expanding = true;
+    for (const token_t &tok : alias.replacement) {
+        const std::vector <token_t> *inner = (tok.type == TOK_IDENT) ? this->expand_alias(tok.value.symbol) : nullptr;
+        if (inner != nullptr)
+            expansion.insert(expansion.end(), inner->begin(), inner->end());
+        else
+            expansion.push_back(tok);
+    }
+    alias.expanding = false;
+
+    alias.expansion = std::move(expansion);
+    alias.generation = (cycles == this->alias_cycles) ? this->alias_generation : 0;
+    return &alias.expansion;
+}
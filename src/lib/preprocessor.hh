@@ -3,30 +3,89 @@
 
 #include <map>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "interner.hh"
+#include "sourcebuffer.hh"
+#include "token.hh"
 
 typedef enum Directives {
     DIR_ALIAS,
+    DIR_INCLUDE,
+    DIR_DEFINE,
+    DIR_IF,
+    DIR_ELSE,
+    DIR_END,
     DIR_INVALID
 } directive_e;
 
+// An alias defined with "$alias name replacement"
+// Every later use of the name is replaced by the tokens of the replacement -- the rest of the
+// line. The tokens keep the offsets of the definition, so errors in them point there.
+typedef struct Alias {
+    std::vector <token_t> replacement;  // tokens of the replacement as they were written
+    std::vector <token_t> expansion;    // the replacement with every alias in it expanded -- memoized
+    uint32_t generation = 0;            // alias_generation the expansion was made in -- 0 if it has to be redone
+    bool expanding = false;             // set while the expansion is made, so an alias cannot expand into itself
+} alias_t;
+
+// An $if whose $end has not been read yet
+// Only $ifs in enabled code are tracked -- ones in a disabled region are skipped with it
+typedef struct Condition {
+    uint32_t offset;    // offset of the $if, for errors
+    bool enabled;       // whether the code after the last $if or $else is compiled
+    bool seen_else;
+} condition_t;
+
+// What an $else did to the region after it
+typedef enum ElseResult {
+    ELSE_ENABLED,
+    ELSE_DISABLED,
+    ELSE_UNMATCHED,     // no open $if, or it already had its $else
+} else_result_e;
+
+// An entry of the offset map -- output[output_offset...] was copied from input[source_offset...]
+typedef struct OffsetMapEntry {
+    uint32_t output_offset;
+    uint32_t source_offset;
+} offset_map_entry_t;
+
 class Preprocessor {
     public:
-        std::string input;        // input source code
-        char cur_char;                // current character
-        size_t read_position; // currect read position in the source code
-        size_t position;
+        std::string_view input;   // input source code -- view of the compiler's source buffer
+        std::string output;       // the source with comments and directives taken out -- filled by process()
+        std::vector <offset_map_entry_t> offset_map; // one entry per span of the source copied to the output
         std::map <std::string, directive_e> directives;
+        std::unordered_map <symbol_t, alias_t> aliases; // every alias defined so far, keyed on its name
+        uint32_t alias_generation;                      // bumped by every definition, which makes old expansions stale
+        size_t alias_cycles;                            // number of times an alias was found inside its own expansion
+        std::string directory;                          // directory of the source file -- $include names are relative to it
+        std::unordered_set <std::string> included;      // canonical path of every file included so far -- each is included once
+        std::unordered_set <symbol_t> defines;          // every name given to $define
+        std::vector <condition_t> conditions;           // the open $ifs, innermost last
 
         // Functions
-        Preprocessor (std::string input); 
-
-        void advance_char();
-        char peek_char();
-        std::string process();
-        void single_line_comment();
-        void multi_line_comment();
-        directive_e read_directive();    // read a directive
+        Preprocessor (SourceBuffer *source); 
+
+        std::string_view process();
+        size_t source_offset(size_t output_offset) const; // where a byte of the output came from in the source
+        directive_e read_directive(std::string_view text, size_t &position); // read the directive at text[position] and move past its name
         bool check_directive(std::string directive); // check if directive exists
+        void define_alias(symbol_t name, std::vector <token_t> replacement);
+        const std::vector <token_t> *expand_alias(symbol_t name); // nullptr if the name is not an alias
+        std::string include_path(std::string_view name) const;   // resolve the file name of an $include
+        std::string_view read_name(std::string_view text, size_t &position) const; // the name after a directive -- empty if there is none
+        void define(std::string_view name);
+        bool open_condition(std::string_view name, uint32_t offset); // $if -- true if the region after it is enabled
+        else_result_e flip_condition();                          // $else
+        bool close_condition();                                  // $end -- false if there is no open $if
+        size_t skip_disabled(std::string_view text, size_t position); // position of the $else or $end that ends a disabled region
+
+    private:
+        void copy_span(size_t from, size_t to);
 };
 
 #endif /* PREPROCESSOR */
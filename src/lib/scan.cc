@@ -0,0 +1,334 @@
+#include "scan.hh"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+// Table of one version of every kernel
+typedef struct ScanKernels {
+    const char *name;
+    size_t (*whitespace)(const char *p, const char *end, size_t *newlines);
+    size_t (*identifier)(const char *p, const char *end);
+    size_t (*newlines)(const char *p, const char *end);
+    const char *(*comment_end)(const char *p, const char *end);
+} scan_kernels_t;
+
+/// SCALAR KERNELS ///
+// These are also used to finish off the tail of the input the vector kernels cannot load
+
+static inline bool
+is_whitespace(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// [A-Za-z0-9_] -- or-ing in 0x20 folds upper case letters onto lower case ones
+static inline bool
+is_identifier_char(unsigned char c) {
+    return (unsigned)((c | 0x20) - 'a') < 26 || (unsigned)(c - '0') < 10 || c == '_';
+}
+
+static size_t
+scalar_whitespace(const char *p, const char *end, size_t *newlines) {
+    const char *start = p;
+    size_t lines = 0;
+    while (p < end && is_whitespace(*p)) {
+        lines += (*p == '\n');
+        p++;
+    }
+
+    if (newlines != nullptr)
+        *newlines += lines;
+    return p - start;
+}
+
+static size_t
+scalar_identifier(const char *p, const char *end) {
+    const char *start = p;
+    while (p < end && is_identifier_char(*p))
+        p++;
+
+    return p - start;
+}
+
+static size_t
+scalar_newlines(const char *p, const char *end) {
+    size_t lines = 0;
+    while ((p = (const char*)memchr(p, '\n', end - p)) != nullptr) {
+        lines++;
+        p++;
+    }
+
+    return lines;
+}
+
+static const char*
+scalar_comment_end(const char *p, const char *end) {
+    for (; end - p >= 2; p++) {
+        if (p[0] == '*' && p[1] == '/')
+            return p;
+    }
+
+    return end;
+}
+
+static const scan_kernels_t scalar_kernels = {
+    "scalar",
+    scalar_whitespace,
+    scalar_identifier,
+    scalar_newlines,
+    scalar_comment_end,
+};
+
+#ifdef SCAN_X86
+/// SSE2 KERNELS ///
+// 16 bytes at a time. Every x86_64 CPU has SSE2, so this is the baseline.
+
+__attribute__((target("sse2")))
+static inline __m128i
+sse2_whitespace_mask(__m128i v, __m128i *is_newline) {
+    *is_newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+    __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+    ws = _mm_or_si128(ws, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+    return _mm_or_si128(ws, *is_newline);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+sse2_identifier_mask(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(alpha, digit), under);
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_whitespace(const char *p, const char *end, size_t *newlines) {
+    const char *start = p;
+    while (end - p >= 16) {
+        __m128i is_newline;
+        __m128i ws = sse2_whitespace_mask(_mm_loadu_si128((const __m128i*)p), &is_newline);
+        unsigned ws_bits = (unsigned)_mm_movemask_epi8(ws);
+        unsigned nl_bits = (unsigned)_mm_movemask_epi8(is_newline);
+        if (ws_bits != 0xFFFF) {
+            unsigned stop = __builtin_ctz(~ws_bits);
+            if (newlines != nullptr)
+                *newlines += __builtin_popcount(nl_bits & ((1u << stop) - 1));
+            return (p - start) + stop;
+        }
+        if (newlines != nullptr)
+            *newlines += __builtin_popcount(nl_bits);
+        p += 16;
+    }
+
+    return (p - start) + scalar_whitespace(p, end, newlines);
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_identifier(const char *p, const char *end) {
+    const char *start = p;
+    while (end - p >= 16) {
+        unsigned bits = (unsigned)_mm_movemask_epi8(sse2_identifier_mask(_mm_loadu_si128((const __m128i*)p)));
+        if (bits != 0xFFFF)
+            return (p - start) + __builtin_ctz(~bits);
+        p += 16;
+    }
+
+    return (p - start) + scalar_identifier(p, end);
+}
+
+__attribute__((target("sse2")))
+static size_t
+sse2_newlines(const char *p, const char *end) {
+    size_t lines = 0;
+    const __m128i nl = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        lines += __builtin_popcount((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+        p += 16;
+    }
+
+    return lines + scalar_newlines(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char*
+sse2_comment_end(const char *p, const char *end) {
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i slash = _mm_set1_epi8('/');
+    // the second load reads one byte further, so keep 17 bytes in range
+    while (end - p >= 17) {
+        __m128i first = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), star);
+        __m128i second = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + 1)), slash);
+        unsigned bits = (unsigned)_mm_movemask_epi8(_mm_and_si128(first, second));
+        if (bits != 0)
+            return p + __builtin_ctz(bits);
+        p += 16;
+    }
+
+    return scalar_comment_end(p, end);
+}
+
+static const scan_kernels_t sse2_kernels = {
+    "sse2",
+    sse2_whitespace,
+    sse2_identifier,
+    sse2_newlines,
+    sse2_comment_end,
+};
+
+/// AVX2 KERNELS ///
+// Same as the SSE2 kernels but 32 bytes at a time
+
+__attribute__((target("avx2")))
+static inline __m256i
+avx2_whitespace_mask(__m256i v, __m256i *is_newline) {
+    *is_newline = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+    ws = _mm256_or_si256(ws, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+    return _mm256_or_si256(ws, *is_newline);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+avx2_identifier_mask(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+    __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    return _mm256_or_si256(_mm256_or_si256(alpha, digit), under);
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_whitespace(const char *p, const char *end, size_t *newlines) {
+    const char *start = p;
+    while (end - p >= 32) {
+        __m256i is_newline;
+        __m256i ws = avx2_whitespace_mask(_mm256_loadu_si256((const __m256i*)p), &is_newline);
+        unsigned ws_bits = (unsigned)_mm256_movemask_epi8(ws);
+        unsigned nl_bits = (unsigned)_mm256_movemask_epi8(is_newline);
+        if (ws_bits != 0xFFFFFFFFu) {
+            unsigned stop = __builtin_ctz(~ws_bits);
+            if (newlines != nullptr)
+                *newlines += __builtin_popcount(nl_bits & ((1u << stop) - 1));
+            return (p - start) + stop;
+        }
+        if (newlines != nullptr)
+            *newlines += __builtin_popcount(nl_bits);
+        p += 32;
+    }
+
+    return (p - start) + sse2_whitespace(p, end, newlines);
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_identifier(const char *p, const char *end) {
+    const char *start = p;
+    while (end - p >= 32) {
+        unsigned bits = (unsigned)_mm256_movemask_epi8(avx2_identifier_mask(_mm256_loadu_si256((const __m256i*)p)));
+        if (bits != 0xFFFFFFFFu)
+            return (p - start) + __builtin_ctz(~bits);
+        p += 32;
+    }
+
+    return (p - start) + sse2_identifier(p, end);
+}
+
+__attribute__((target("avx2")))
+static size_t
+avx2_newlines(const char *p, const char *end) {
+    size_t lines = 0;
+    const __m256i nl = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        lines += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+        p += 32;
+    }
+
+    return lines + sse2_newlines(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char*
+avx2_comment_end(const char *p, const char *end) {
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i slash = _mm256_set1_epi8('/');
+    while (end - p >= 33) {
+        __m256i first = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), star);
+        __m256i second = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + 1)), slash);
+        unsigned bits = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(first, second));
+        if (bits != 0)
+            return p + __builtin_ctz(bits);
+        p += 32;
+    }
+
+    return sse2_comment_end(p, end);
+}
+
+static const scan_kernels_t avx2_kernels = {
+    "avx2",
+    avx2_whitespace,
+    avx2_identifier,
+    avx2_newlines,
+    avx2_comment_end,
+};
+#endif /* SCAN_X86 */
+
+// Pick the kernels to use for the rest of the program
+// THUNDER_SCAN can force a version, but never one the CPU does not support
+static const scan_kernels_t*
+select_kernels() {
+    const char *forced = getenv("THUNDER_SCAN");
+    if (forced != nullptr && strcmp(forced, "scalar") == 0)
+        return &scalar_kernels;
+
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+    bool has_sse2 = __builtin_cpu_supports("sse2");
+
+    if (forced != nullptr && strcmp(forced, "sse2") == 0 && has_sse2)
+        return &sse2_kernels;
+    if (has_avx2)
+        return &avx2_kernels;
+    if (has_sse2)
+        return &sse2_kernels;
+#endif
+
+    return &scalar_kernels;
+}
+
+static const scan_kernels_t *kernels = select_kernels();
+
+size_t
+scan_whitespace(const char *p, const char *end, size_t *newlines) {
+    return kernels->whitespace(p, end, newlines);
+}
+
+size_t
+scan_identifier(const char *p, const char *end) {
+    return kernels->identifier(p, end);
+}
+
+size_t
+count_newlines(const char *p, const char *end) {
+    return kernels->newlines(p, end);
+}
+
+const char*
+find_comment_end(const char *p, const char *end) {
+    return kernels->comment_end(p, end);
+}
+
+const char*
+scan_kernel_name() {
+    return kernels->name;
+}
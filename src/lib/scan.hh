@@ -0,0 +1,36 @@
+/*
+ *    scan.hh
+ *
+ *    This file contains the scanning kernels the lexer and preprocessor use
+ *    to skip over runs of characters
+ *
+ */
+
+#pragma once
+#ifndef SCAN_
+#define SCAN_
+
+#include <cstddef>
+
+// Each kernel has a scalar, SSE2 and AVX2 version. The fastest one the CPU supports is
+// selected the first time the program runs. Setting THUNDER_SCAN to "scalar", "sse2"
+// or "avx2" forces a specific version, which is useful for testing and benchmarking.
+// None of the kernels read outside of [p, end).
+
+// Length of the run of whitespace (' ', '\t', '\r', '\n') starting at p
+// The number of '\n' characters in the run is added to *newlines, unless newlines is nullptr
+size_t scan_whitespace(const char *p, const char *end, size_t *newlines);
+
+// Length of the run of identifier characters ([A-Za-z0-9_]) starting at p
+size_t scan_identifier(const char *p, const char *end);
+
+// Number of '\n' characters in [p, end)
+size_t count_newlines(const char *p, const char *end);
+
+// Pointer to the '*' of the first "*/" in [p, end) -- end if there is none
+const char *find_comment_end(const char *p, const char *end);
+
+// Name of the kernel set in use -- "scalar", "sse2" or "avx2"
+const char *scan_kernel_name();
+
+#endif /* SCAN_ */
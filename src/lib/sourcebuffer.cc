@@ -0,0 +1,90 @@
+#include "sourcebuffer.hh"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Constructor for an empty source buffer
+SourceBuffer::SourceBuffer() {
+    this->mapped = nullptr;
+    this->length = 0;
+}
+
+// Constructor for a source that already lives in memory
+SourceBuffer::SourceBuffer(std::string text, std::string name) {
+    this->path = std::move(name);
+    this->mapped = nullptr;
+    this->storage = std::move(text);
+    this->length = this->storage.length();
+}
+
+// Destructor -- unmap the file if we mapped it
+SourceBuffer::~SourceBuffer() {
+    if (this->mapped != nullptr)
+        munmap(this->mapped, this->length);
+}
+
+// Load the source code from a file
+// Regular files are mapped directly. Anything else (pipes, ttys, "-" for stdin)
+// cannot be mapped, so it is read into the storage string until EOF
+bool
+SourceBuffer::load_file(const char *file_name) {
+    int fd;
+    struct stat st;
+
+    this->path = file_name;
+    if (this->path == "-") {
+        fd = STDIN_FILENO;
+    } else {
+        fd = open(file_name, O_RDONLY);
+        if (fd < 0) {
+            perror("load_file (open)");
+            return false;
+        }
+    }
+
+    if (fstat(fd, &st) != 0) {
+        perror("load_file (fstat)");
+        if (fd != STDIN_FILENO) close(fd);
+        return false;
+    }
+
+    // Empty files cannot be mapped, but they are still valid sources
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, st.st_size, MADV_SEQUENTIAL);
+            this->mapped = (char*)addr;
+            this->length = st.st_size;
+            if (fd != STDIN_FILENO) close(fd);
+            return true;
+        }
+    }
+
+    // Fallback: read the stream in chunks
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            perror("load_file (read)");
+            if (fd != STDIN_FILENO) close(fd);
+            return false;
+        }
+        this->storage.append(buf, n);
+    }
+    this->length = this->storage.length();
+
+    if (fd != STDIN_FILENO) close(fd);
+    return true;
+}
+
+// Get a view of the entire source code
+std::string_view
+SourceBuffer::text() const {
+    if (this->mapped != nullptr)
+        return std::string_view(this->mapped, this->length);
+
+    return std::string_view(this->storage.data(), this->length);
+}
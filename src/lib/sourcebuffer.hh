@@ -0,0 +1,37 @@
+/*
+ *    sourcebuffer.hh
+ *
+ *    This file contains the buffer that holds the source code of a
+ *    single input file for the whole front end
+ *
+ */
+
+#pragma once
+#ifndef SOURCE_BUFFER_
+#define SOURCE_BUFFER_
+
+#include <string>
+#include <string_view>
+
+// Source code buffer
+// Regular files are memory mapped so the front end never copies the source.
+// Pipes and other streams that cannot be mapped are read into 'storage' instead.
+// Nothing in the front end writes to the source, so the mapping is read only.
+class SourceBuffer {
+    public:
+        std::string path;        // name of the file the source came from
+        char *mapped;            // start of the mapped file -- nullptr if not mapped
+        size_t length;           // length of the source in bytes
+        std::string storage;     // holds the source when it could not be mapped
+
+        SourceBuffer();
+        SourceBuffer(std::string text, std::string name); // in-memory source -- used for tests and generated code
+        ~SourceBuffer();
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+        bool load_file(const char *file_name); // map or read the file -- returns false on failure
+        std::string_view text() const;         // read-only view of the entire source
+};
+
+#endif /* SOURCE_BUFFER_ */
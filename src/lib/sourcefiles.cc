@@ -0,0 +1,56 @@
+#include "sourcefiles.hh"
+
+#include <algorithm>
+
+SourceFiles source_files;
+
+// Give a file the next range of offsets
+// One offset past the end is kept free for the file's TOK_EOF
+uint32_t
+SourceFiles::add(std::string path, std::string_view text) {
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    if ((uint64_t)this->next_base + text.length() + 1 > UINT32_MAX)
+        return 0;
+
+    uint32_t base = this->next_base;
+    this->files.push_back(source_file_t{std::move(path), text, base, LineTable(text)});
+    this->next_base += (uint32_t)text.length() + 1;
+    return base;
+}
+
+// Find the file and the line and column an offset is at
+bool
+SourceFiles::locate(uint32_t offset, std::string *path, source_location_t *loc) {
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    source_file_t *file = this->find(offset);
+    if (file == nullptr)
+        return false;
+
+    *path = file->path;
+    *loc = file->lines.locate(offset - file->base);
+    return true;
+}
+
+// Slice the source of an included file
+std::string_view
+SourceFiles::text(uint32_t offset, size_t length) {
+    std::lock_guard<std::mutex> guard(this->lock);
+
+    source_file_t *file = this->find(offset);
+    if (file == nullptr)
+        return std::string_view();
+    return file->text.substr(offset - file->base, length);
+}
+
+// The file whose range holds an offset -- the lock has to be held
+source_file_t*
+SourceFiles::find(uint32_t offset) {
+    if (offset < INCLUDE_OFFSET_BASE || offset >= this->next_base)
+        return nullptr;
+
+    auto it = std::upper_bound(this->files.begin(), this->files.end(), offset,
+        [](uint32_t offset, const source_file_t &file) { return offset < file.base; });
+    return &*(it - 1);
+}
@@ -0,0 +1,55 @@
+/*
+ *    sourcefiles.hh
+ *
+ *    This file contains the registry of the files pulled into a
+ *    compilation by $include and the offset space they share
+ *
+ */
+
+#pragma once
+#ifndef SOURCE_FILES_
+#define SOURCE_FILES_
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "linetable.hh"
+
+// Offsets below this belong to the file being compiled, offsets from here up to
+// included files. Every included file gets its own range, so a token or error
+// from any file is still located by its offset alone.
+#define INCLUDE_OFFSET_BASE 0x80000000u
+
+// An included file and where it sits in the offset space
+typedef struct SourceFile {
+    std::string path;       // canonical path of the file
+    std::string_view text;  // the file's source -- owned by the include cache
+    uint32_t base;          // offset of text[0]
+    LineTable lines;
+} source_file_t;
+
+// Source files
+// Files are only ever added, so a range handed out once stays valid for the
+// life of the process. Shared by every compiler, so it is guarded by a lock.
+class SourceFiles {
+    public:
+        std::mutex lock;
+        std::deque <source_file_t> files;   // in order of their base
+        uint32_t next_base;                 // where the next file will start
+
+        SourceFiles() : next_base(INCLUDE_OFFSET_BASE) {}
+
+        uint32_t add(std::string path, std::string_view text); // give a file a range -- returns its base, 0 if the offset space is full
+        bool locate(uint32_t offset, std::string *path, source_location_t *loc); // false if no included file holds the offset
+        std::string_view text(uint32_t offset, size_t length);  // the source at an offset -- empty if no included file holds it
+        
+    private:
+        source_file_t *find(uint32_t offset);
+};
+
+extern SourceFiles source_files;
+
+#endif /* SOURCE_FILES_ */
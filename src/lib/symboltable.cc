@@ -1,6 +1,17 @@
 #include "symboltable.hh"
 #include "token.hh"
-#include <map>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#define SYMBOL_TABLE_INITIAL_SLOTS 8
+
+// Slot a name hashes to -- symbol IDs are handed out in order, so they are mixed first
+static inline uint32_t
+slot_of(symbol_t name, uint32_t capacity) {
+    uint32_t hash = name * 0x9E3779B1u;
+    return (hash ^ (hash >> 15)) & (capacity - 1);
+}
 
 // Get string based on data type enum
 std::string
@@ -27,36 +38,80 @@ get_dt(DataType dt) {
     return rv;
 }
 
-// Finds if an element is in the symbol table already
-// returns 'true' if the element exists, 'false' otherwise
-bool
-SymbolTable::find(std::string name) {
-    if (this->elements.find(name) != this->elements.end()) {
-        // element is in map already
-        return true;
-    } else {
-        return false;
+// Finds an element in the symbol table
+// returns nullptr if the name is not in the table
+SymbolTableEntry*
+SymbolTable::lookup(symbol_t name) {
+    if (this->count == 0)
+        return nullptr;
+
+    uint32_t mask = this->capacity - 1;
+    for (uint32_t i = slot_of(name, this->capacity); this->slots[i] != nullptr; i = (i + 1) & mask) {
+        if (this->slots[i]->name == name)
+            return this->slots[i];
     }
+    return nullptr;
 }
 
 // Adds an element to the symbol table
 void
-SymbolTable::add(std::shared_ptr<SymbolTableEntry> entry) {
-    this->elements[entry->name] = std::move(entry);
+SymbolTable::add(SymbolTableEntry *entry) {
+    if ((this->count + 1) * 2 > this->capacity)
+        this->grow();
+
+    uint32_t mask = this->capacity - 1;
+    uint32_t i = slot_of(entry->name, this->capacity);
+    for (; this->slots[i] != nullptr; i = (i + 1) & mask) {
+        if (this->slots[i]->name == entry->name) {
+            this->slots[i] = entry;
+            return;
+        }
+    }
+    this->slots[i] = entry;
+    this->count++;
 }
 
+// Double the number of slots
+// The old slots are left in the arena -- they add up to less than the new ones
+void
+SymbolTable::grow() {
+    uint32_t old_capacity = this->capacity;
+    SymbolTableEntry **old_slots = this->slots;
+
+    this->capacity = old_capacity == 0 ? SYMBOL_TABLE_INITIAL_SLOTS : old_capacity * 2;
+    this->slots = (SymbolTableEntry**)this->arena->allocate(sizeof(SymbolTableEntry*) * this->capacity, alignof(SymbolTableEntry*));
+    memset(this->slots, 0, sizeof(SymbolTableEntry*) * this->capacity);
+
+    uint32_t mask = this->capacity - 1;
+    for (uint32_t j = 0; j < old_capacity; j++) {
+        if (old_slots[j] == nullptr)
+            continue;
+        uint32_t i = slot_of(old_slots[j]->name, this->capacity);
+        while (this->slots[i] != nullptr)
+            i = (i + 1) & mask;
+        this->slots[i] = old_slots[j];
+    }
+}
+
+// Print the entries in the order their names were interned
 void
 SymbolTable::print_elements() {
-    std::map<std::string, std::shared_ptr<SymbolTableEntry> >::iterator it;
-    for (it = this->elements.begin(); it != this->elements.end(); it++) {
-        it->second->print();
+    std::vector <SymbolTableEntry*> entries;
+    for (uint32_t i = 0; i < this->capacity; i++) {
+        if (this->slots[i] != nullptr)
+            entries.push_back(this->slots[i]);
     }
+    std::sort(entries.begin(), entries.end(),
+        [](const SymbolTableEntry *a, const SymbolTableEntry *b) { return a->name < b->name; });
+
+    for (SymbolTableEntry *entry : entries)
+        entry->print();
 }
 
 void
 SymbolTableEntry::print() {
     printf("[\"%s\"] type: [%s] size: %dbits dimensions: %d decl-line: %d\n", 
-        this->name.c_str(),
+        symbol_name(this->name).c_str(),
         get_dt(this->data_type).c_str(),
         this->size,
         this->dimensions,
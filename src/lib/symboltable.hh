@@ -3,17 +3,16 @@
 #define SYMBOL_TABLE
 
 #include "token.hh"
-#include <map>
+#include "interner.hh"
+#include "arena.hh"
 #include <string>
 #include <cstdint>
-#include <memory>
-#include <vector>
 
 // Entry member of a symbol table
 // Contains information about an identifier stored in a scope's symbol table
 class SymbolTableEntry {
     public:
-        std::string name;        // identifier string -- name of the identifier/variable
+        symbol_t name;           // interned name of the identifier/variable
         DataType data_type;    // data type of the element -- return type for functions
         uint32_t size;             // size in memory of the element in bits [NOT BYTES]
         uint32_t dimensions; // dimensions of the element -- 0 for normal, 1 for 1D array, 2 for 2D array...
@@ -21,12 +20,12 @@ class SymbolTableEntry {
         uint32_t usage_line; // line of usage of the element
         uint64_t mem_addr;     // location in memory of the element
         uint64_t num_args;     // number of arguments of a function 
-        std::vector <DataType> arg_data_types; // list of argument data types
+        ArenaList <DataType> arg_data_types; // list of argument data types
 
 
         // Member functions
         SymbolTableEntry(
-            std::string(name),
+            symbol_t name,
             DataType data_type,
             uint32_t size,
             uint32_t dimensions, 
@@ -42,12 +41,24 @@ class SymbolTableEntry {
 };
 
 // The symbol table itself
+// An open addressing hash table on the interned name. The table and its entries live in
+// the compilation's arena, and a scope that declares nothing never allocates a table.
 class SymbolTable {
     public:
-        std::map <std::string, std::shared_ptr<SymbolTableEntry> > elements;
-        bool find(std::string name); // find an element in the table, if it is in the table return true
-        void add(std::shared_ptr<SymbolTableEntry> entry); // add an element into the symbol table
+        Arena *arena;                   // arena the table grows in -- DO NOT FREE
+        SymbolTableEntry **slots;       // nullptr for an empty slot -- never more than half full
+        uint32_t capacity;              // number of slots, a power of 2 -- 0 until the first add
+        uint32_t count;                 // number of entries
+
+        SymbolTable(Arena *arena) : arena(arena), slots(nullptr), capacity(0), count(0) {}
+
+        SymbolTableEntry *lookup(symbol_t name); // the entry for a name -- nullptr if it is not in the table
+        bool find(symbol_t name) { return this->lookup(name) != nullptr; } // true if the name is in the table
+        void add(SymbolTableEntry *entry); // add an element into the symbol table -- replaces one with the same name
         void print_elements();
+
+    private:
+        void grow();
 };
 
 
@@ -0,0 +1,78 @@
+#include "threadpool.hh"
+
+// Constructor
+// Start the workers -- they wait for a batch of jobs right away
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    this->job = nullptr;
+    this->job_count = 0;
+    this->next_job = 0;
+    this->jobs_left = 0;
+    this->batch = 0;
+    this->stopping = false;
+
+    for (size_t i = 0; i < threads; i++)
+        this->workers.emplace_back(&ThreadPool::work, this);
+}
+
+// Destructor
+// Wake every worker up so they see the pool is stopping and wait for them to exit
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+
+    for (size_t i = 0; i < this->workers.size(); i++)
+        this->workers[i].join();
+}
+
+// Call job(i) for every i in [0, count) on the workers and wait until all of them finished
+void
+ThreadPool::run(size_t count, const std::function<void(size_t)> &job) {
+    if (count == 0)
+        return;
+
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->job = &job;
+    this->job_count = count;
+    this->next_job = 0;
+    this->jobs_left = count;
+    this->batch++;
+    this->wake.notify_all();
+
+    this->done.wait(guard, [this] { return this->jobs_left == 0; });
+    this->job = nullptr;
+}
+
+// Worker loop
+// Take jobs out of the current batch until it runs dry, then sleep until the next one
+void
+ThreadPool::work() {
+    size_t seen_batch = 0;
+    std::unique_lock<std::mutex> guard(this->lock);
+
+    while (true) {
+        this->wake.wait(guard, [&] { return this->stopping || this->batch != seen_batch; });
+        if (this->stopping)
+            return;
+        seen_batch = this->batch;
+
+        while (this->next_job < this->job_count) {
+            size_t i = this->next_job++;
+            const std::function<void(size_t)> *job = this->job;
+
+            guard.unlock();
+            (*job)(i);
+            guard.lock();
+
+            if (--this->jobs_left == 0)
+                this->done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ *    threadpool.hh
+ *
+ *    This file contains the pool of worker threads the front end
+ *    uses to split up work on large inputs
+ *
+ */
+
+#pragma once
+#ifndef THREAD_POOL_
+#define THREAD_POOL_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread pool
+// The workers are started once and sleep until a batch of jobs is handed to run().
+// A batch is a count and a function: job(i) is called once for every i in [0, count),
+// on whichever worker gets to it first. run() returns once every job has finished.
+// Only one batch runs at a time, and run() must not be called from inside a job.
+class ThreadPool {
+    public:
+        std::vector <std::thread> workers;
+        std::mutex lock;
+        std::condition_variable wake;       // signals the workers that a batch started or the pool is shutting down
+        std::condition_variable done;       // signals run() that the last job of the batch finished
+
+        const std::function<void(size_t)> *job; // current batch -- nullptr when idle. DO NOT FREE
+        size_t job_count;                   // number of jobs in the batch
+        size_t next_job;                    // index of the next job to hand out
+        size_t jobs_left;                   // number of jobs not finished yet
+        size_t batch;                       // incremented every time a batch starts
+        bool stopping;
+
+        ThreadPool(size_t threads = 0);     // 0 means one thread per hardware thread
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t size() const { return this->workers.size(); }
+        void run(size_t count, const std::function<void(size_t)> &job);
+
+    private:
+        void work();
+};
+
+#endif /* THREAD_POOL_ */
@@ -9,7 +9,9 @@
 #ifndef TOKEN_
 #define TOKEN_
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 /* KEYWORDS */
 /*
@@ -94,12 +96,24 @@ enum DataType {
     TYPE_VOID,     // void type -- currently only used by the compiler
 };
 
+// Value of a numeric literal -- the lexer decodes it once so nothing after it has to
+typedef union TokenValue {
+    int64_t int_value;               // value of a TOK_INT
+    double float_value;              // value of a TOK_FLOAT
+    uint32_t symbol;                 // interned name of a TOK_IDENT -- see interner.hh
+} token_value_t;
+
 // Structure for tokens that the lexer creates
 typedef struct Token {
-    int line_num;                // the line number of the source code the token exists in
-    TokenType type;            // the actual token enum
-    std::string literal; // the literal of the token -- identifier string or the symbol that it represents
+    uint32_t offset = 0;             // byte offset of the token in the source -- see LineTable for its line
+    TokenType type = TOK_ILLEGAL;    // the actual token enum
+    std::string_view literal;        // the literal of the token -- slice of the source buffer it was read from
+    token_value_t value = {0};       // decoded value of TOK_INT and TOK_FLOAT tokens, symbol of TOK_IDENT -- unused otherwise
 } token_t;
 
+// printf helpers for string views -- printf(SV_FMT "\n", SV_ARG(tok.literal))
+#define SV_FMT "%.*s"
+#define SV_ARG(sv) (int)(sv).size(), (sv).data()
+
 
 #endif /* TOKEN_ */
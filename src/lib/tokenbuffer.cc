@@ -0,0 +1,57 @@
+#include "tokenbuffer.hh"
+#include "token.hh"
+#include "sourcefiles.hh"
+
+static_assert(TOK_ENTRY <= UINT8_MAX, "TokenType no longer fits in the token buffer's type column");
+
+// Append a token to the end of the buffer
+// The token's literal has to be the slice of the source at its offset -- either the
+// buffer's own source or an included file's
+void
+TokenBuffer::push(const token_t &tok) {
+    this->types.push_back((uint8_t)tok.type);
+    this->offsets.push_back(tok.offset);
+    this->lengths.push_back((uint32_t)tok.literal.length());
+
+    if (tok.type == TOK_INT || tok.type == TOK_FLOAT) {
+        this->payloads.push_back((uint32_t)this->values.size());
+        this->values.push_back(tok.value);
+    } else if (tok.type == TOK_IDENT) {
+        this->payloads.push_back(tok.value.symbol);
+    } else {
+        this->payloads.push_back(0);
+    }
+}
+
+// Remove all the tokens from the buffer
+void
+TokenBuffer::clear() {
+    this->types.clear();
+    this->offsets.clear();
+    this->lengths.clear();
+    this->payloads.clear();
+    this->values.clear();
+}
+
+// Rebuild the token at index i
+token_t
+TokenBuffer::get(size_t i) const {
+    token_t tok;
+    tok.type = (TokenType)this->types[i];
+    tok.offset = this->offsets[i];
+    tok.literal = this->literal(i);
+    if (tok.type == TOK_INT || tok.type == TOK_FLOAT)
+        tok.value = this->values[this->payloads[i]];
+    else if (tok.type == TOK_IDENT)
+        tok.value.symbol = this->payloads[i];
+    return tok;
+}
+
+// Slice the literal of the token at index i out of the source it came from
+std::string_view
+TokenBuffer::literal(size_t i) const {
+    uint32_t local = this->offsets[i] - this->base;
+    if (this->offsets[i] >= this->base && local <= this->source.length())
+        return this->source.substr(local, this->lengths[i]);
+    return source_files.text(this->offsets[i], this->lengths[i]);
+}
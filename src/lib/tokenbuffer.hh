@@ -0,0 +1,49 @@
+/*
+ *    tokenbuffer.hh
+ *
+ *    This file contains the buffer that stores the token stream of a source file
+ *
+ */
+
+#pragma once
+#ifndef TOKEN_BUFFER_
+#define TOKEN_BUFFER_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "token.hh"
+
+// Token buffer
+// Tokens are stored as a struct of arrays: one column per field instead of one
+// token_t per token. A token is its type, the offset and length of its literal
+// in the source, and a 32 bit payload -- 13 bytes with no heap allocation
+// of its own. The literal is only sliced out of the source when a token_t is requested.
+// Numeric values are rare enough that they live in a side pool the payload indexes.
+// Tokens spliced in from an included file keep that file's offsets, which fall outside
+// of 'source', and have their literal looked up in the registry of source files instead.
+class TokenBuffer {
+    public:
+        std::string_view source;          // the source code the token offsets point into
+        uint32_t base = 0;                // offset of source[0]
+        std::vector <uint8_t> types;      // TokenType of each token
+        std::vector <uint32_t> offsets;   // offset of each token's literal in the source
+        std::vector <uint32_t> lengths;   // length of each token's literal
+        std::vector <uint32_t> payloads;  // TOK_INT/TOK_FLOAT: index of the token's value in 'values', TOK_IDENT: its symbol
+        std::vector <token_value_t> values; // decoded values of the numeric tokens
+
+        TokenBuffer() {}
+        TokenBuffer(std::string_view source, uint32_t base = 0) : source(source), base(base) {}
+
+        void push(const token_t &tok);    // append a token -- its literal must be the slice of the source at its offset
+        void clear();                     // remove all tokens
+        size_t size() const { return this->types.size(); }
+
+        // Accessors for a single token
+        TokenType type(size_t i) const { return (TokenType)this->types[i]; }
+        std::string_view literal(size_t i) const;
+        token_t get(size_t i) const;      // rebuild the full token
+};
+
+#endif /* TOKEN_BUFFER_ */
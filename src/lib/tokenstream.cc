@@ -0,0 +1,79 @@
+#include "tokenstream.hh"
+#include "lexer.hh"
+
+static_assert((TOKEN_LOOKAHEAD & (TOKEN_LOOKAHEAD - 1)) == 0, "TOKEN_LOOKAHEAD must be a power of 2");
+
+// Constructor for a stream that pulls tokens from a lexer
+TokenStream::TokenStream(Lexer *lexer) {
+    this->lexer = lexer;
+    this->buffer = nullptr;
+    this->buffer_position = 0;
+    this->buffer_end = 0;
+    this->head = 0;
+    this->count = 0;
+}
+
+// Constructor for a stream that reads an already filled token buffer
+TokenStream::TokenStream(const TokenBuffer &buffer) {
+    this->lexer = nullptr;
+    this->buffer = &buffer;
+    this->buffer_position = 0;
+    this->buffer_end = buffer.size();
+    this->head = 0;
+    this->count = 0;
+}
+
+// Constructor for a stream over a span of an already filled token buffer
+// The stream ends at 'end' as if the buffer did
+TokenStream::TokenStream(const TokenBuffer &buffer, size_t begin, size_t end) {
+    this->lexer = nullptr;
+    this->buffer = &buffer;
+    this->buffer_position = begin;
+    this->buffer_end = end;
+    this->head = 0;
+    this->count = 0;
+}
+
+// Consume the current token
+// Only the head of the ring moves, the token itself stays where it is until the ring wraps
+void
+TokenStream::advance() {
+    if (this->count == 0)
+        this->pull();
+    this->head = (this->head + 1) & (TOKEN_LOOKAHEAD - 1);
+    this->count--;
+}
+
+// Make the token at a buffer index the current one
+// Only streams reading a buffer can seek. Anything looked ahead at is dropped.
+void
+TokenStream::seek(size_t position) {
+    this->buffer_position = position;
+    this->head = 0;
+    this->count = 0;
+}
+
+// Read one more token into the ring buffer
+// A buffer that runs out keeps repeating its last token, which is TOK_EOF.
+// A span that runs out repeats a TOK_EOF at the offset of the token after it.
+void
+TokenStream::pull() {
+    token_t &tok = this->ring[(this->head + this->count) & (TOKEN_LOOKAHEAD - 1)];
+    if (this->lexer != nullptr) {
+        tok = this->lexer->next_token();
+    } else if (this->buffer_position < this->buffer_end) {
+        tok = this->buffer->get(this->buffer_position);
+        this->buffer_position++;
+    } else if (this->buffer_end < this->buffer->size()) {
+        tok = token_t();
+        tok.type = TOK_EOF;
+        tok.offset = this->buffer->offsets[this->buffer_end];
+    } else if (this->buffer->size() > 0) {
+        tok = this->buffer->get(this->buffer->size() - 1);
+    } else {
+        tok = token_t();
+        tok.type = TOK_EOF;
+    }
+
+    this->count++;
+}
@@ -0,0 +1,58 @@
+/*
+ *    tokenstream.hh
+ *
+ *    This file contains the stream that feeds tokens to the parser
+ *
+ */
+
+#pragma once
+#ifndef TOKEN_STREAM_
+#define TOKEN_STREAM_
+
+#include <cstddef>
+
+#include "token.hh"
+#include "tokenbuffer.hh"
+
+class Lexer;
+
+// Number of tokens the stream can look ahead -- must be a power of 2
+#define TOKEN_LOOKAHEAD 16
+
+// Token stream
+// The parser reads its tokens through this stream. Tokens are either pulled from a lexer
+// on demand, so the full token stream never has to exist at once, or read from a token
+// buffer the stream borrows, which is already filled. Every token is built once, when it
+// enters a small ring buffer, and read in place after that: peek(k) is an index into the
+// ring and advancing only moves the head, so no token is ever copied by the stream.
+class TokenStream {
+    public:
+        Lexer *lexer;                       // lexer to pull tokens from -- nullptr when reading a buffer. DO NOT FREE
+        const TokenBuffer *buffer;          // buffer to read tokens from -- nullptr when pulling from a lexer. DO NOT FREE
+        size_t buffer_position;             // index of the next token to read from the buffer
+        size_t buffer_end;                  // index the stream stops at -- tokens past it read as TOK_EOF
+        token_t ring[TOKEN_LOOKAHEAD];      // tokens read but not consumed yet
+        size_t head;                        // index in the ring of the current token
+        size_t count;                       // number of tokens in the ring
+
+        TokenStream(Lexer *lexer);
+        TokenStream(const TokenBuffer &buffer);
+        TokenStream(const TokenBuffer &buffer, size_t begin, size_t end); // only the tokens in [begin, end)
+
+        // Look at the token k ahead of the current one -- k < TOKEN_LOOKAHEAD
+        // The reference stays valid until the stream advances past the token
+        const token_t &peek(size_t k) {
+            while (this->count <= k)
+                this->pull();
+            return this->ring[(this->head + k) & (TOKEN_LOOKAHEAD - 1)];
+        }
+
+        void advance();                     // consume the current token
+        size_t position() const { return this->buffer_position - this->count; } // buffer index of the current token
+        void seek(size_t position);         // make the token at a buffer index the current one
+
+    private:
+        void pull();                        // read one more token into the ring
+};
+
+#endif /* TOKEN_STREAM_ */
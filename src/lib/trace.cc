@@ -0,0 +1,125 @@
+#include "trace.hh"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+
+// One message in the ring
+// sequence is the message's number + 1 once it has been written, so a slot that is
+// empty or being rewritten by another thread can be told apart when dumping
+struct trace_entry_t {
+    std::atomic <uint64_t> sequence;
+    uint32_t category;
+    char message[TRACE_MESSAGE_SIZE];
+};
+
+uint32_t trace_mask = 0;
+
+// The ring lives in bss, so its pages are only touched once tracing writes to them
+static trace_entry_t trace_ring[TRACE_RING_SIZE];
+static std::atomic <uint64_t> trace_next(0);
+
+static const struct {
+    const char *name;
+    uint32_t category;
+} trace_names[] = {
+    { "lexer",          TRACE_LEXER },
+    { "parser",         TRACE_PARSER },
+    { "preprocessor",   TRACE_PREPROCESSOR },
+    { "sema",           TRACE_SEMA },
+    { "all",            TRACE_ALL },
+};
+
+// Name of a single category for the dump
+static const char*
+category_name(uint32_t category) {
+    for (const auto &entry : trace_names)
+        if (entry.category == category)
+            return entry.name;
+    return "?";
+}
+
+static void
+dump_at_exit() {
+    trace_dump(stderr);
+}
+
+// Switch on the categories named in a comma separated list
+bool
+trace_enable(const char *categories) {
+    if (categories == nullptr)
+        return true;
+
+    bool valid = true;
+    uint32_t mask = 0;
+    const char *p = categories;
+    while (*p) {
+        size_t length = strcspn(p, ",");
+        bool found = false;
+        for (const auto &entry : trace_names) {
+            if (strlen(entry.name) == length && strncmp(entry.name, p, length) == 0) {
+                mask |= entry.category;
+                found = true;
+                break;
+            }
+        }
+        if (!found && length > 0) {
+            fprintf(stderr, "trace: unknown category '%.*s'\n", (int)length, p);
+            valid = false;
+        }
+        p += length;
+        if (*p == ',')
+            p++;
+    }
+
+    // Only hook the dump once, however many times tracing is switched on
+    if (mask && trace_mask == 0)
+        atexit(dump_at_exit);
+    trace_mask |= mask;
+
+    return valid;
+}
+
+// Format a message into the next slot of the ring
+// Taking the slot is a single atomic add, so the lexer threads can trace too
+void
+trace_write(uint32_t category, const char *format, ...) {
+    uint64_t sequence = trace_next.fetch_add(1, std::memory_order_relaxed);
+    trace_entry_t &entry = trace_ring[sequence % TRACE_RING_SIZE];
+
+    entry.sequence.store(0, std::memory_order_relaxed);
+    entry.category = category;
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(entry.message, TRACE_MESSAGE_SIZE, format, args);
+    va_end(args);
+
+    // Messages usually end in a newline already -- the dump adds its own
+    if (length > 0) {
+        size_t end = (size_t)length < TRACE_MESSAGE_SIZE ? length : TRACE_MESSAGE_SIZE - 1;
+        if (entry.message[end - 1] == '\n')
+            entry.message[end - 1] = '\0';
+    }
+
+    entry.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+// Print the messages in the ring, oldest first
+// Messages that were overwritten before they could be printed are counted instead
+void
+trace_dump(FILE *out) {
+    uint64_t next = trace_next.load(std::memory_order_acquire);
+    uint64_t first = next > TRACE_RING_SIZE ? next - TRACE_RING_SIZE : 0;
+
+    if (first > 0)
+        fprintf(out, "trace: %lu older messages dropped\n", (unsigned long)first);
+
+    for (uint64_t i = first; i < next; i++) {
+        const trace_entry_t &entry = trace_ring[i % TRACE_RING_SIZE];
+        if (entry.sequence.load(std::memory_order_acquire) != i + 1)
+            continue;
+        fprintf(out, "[%s] %s\n", category_name(entry.category), entry.message);
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ *    trace.hh
+ *
+ *    This file contains the trace facility of the front end
+ *
+ */
+
+#pragma once
+#ifndef TRACE_
+#define TRACE_
+
+#include <cstdint>
+#include <cstdio>
+
+// Parts of the compiler that can be traced
+// Each one is a bit so any set of them can be switched on at once
+enum trace_category_e : uint32_t {
+    TRACE_LEXER         = 1u << 0,
+    TRACE_PARSER        = 1u << 1,
+    TRACE_PREPROCESSOR  = 1u << 2,
+    TRACE_SEMA          = 1u << 3,
+    TRACE_ALL           = TRACE_LEXER | TRACE_PARSER | TRACE_PREPROCESSOR | TRACE_SEMA,
+};
+
+// Number of messages the ring keeps -- older ones are overwritten
+// and the size of one message, longer ones are cut
+#define TRACE_RING_SIZE 4096
+#define TRACE_MESSAGE_SIZE 120
+
+// TRACE(category, format, ...)
+// Record a message when category is switched on
+// Release builds (NDEBUG) compile every trace point to nothing: the arguments are never
+// evaluated and the call is dead code, but the format is still checked against them.
+// Debug builds pay one load and a branch per trace point while tracing is off.
+#ifdef NDEBUG
+#define TRACE(category, ...) \
+    do { if (false) trace_write((category), __VA_ARGS__); } while (0)
+#else
+#define TRACE(category, ...) \
+    do { if (trace_mask & (category)) trace_write((category), __VA_ARGS__); } while (0)
+#endif
+
+// Categories that are switched on -- none by default
+extern uint32_t trace_mask;
+
+// Switch on the categories named in a comma separated list
+// e.g. "parser,sema" or "all". A null list switches nothing on.
+// The ring is printed to stderr when the program exits.
+// Returns false when a name is not a category
+bool trace_enable(const char *categories);
+
+// Format a message into the next slot of the ring
+void trace_write(uint32_t category, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Print the messages in the ring, oldest first
+void trace_dump(FILE *out);
+
+#endif
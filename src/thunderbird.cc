@@ -1,93 +1,101 @@
 #include <iostream>
-#include <sstream>
-#include <fstream>
 #include <string>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
 #include <vector>
 #include <unistd.h>
-#include <sys/stat.h>
 #include "compiler.hh"
 #include "lexer.hh"
 #include "token.hh"
 #include "ast.hh"
 #include "parser.hh"
+#include "preprocessor.hh"
+#include "sourcebuffer.hh"
+#include "threadpool.hh"
+#include "trace.hh"
 
 bool test_lexer();
-std::string read_file(char *file_name);
+bool test_parallel_lexer();
+bool test_parser_recovery();
+SourceBuffer* read_file(char *file_name);
 
 
 int
 main(int argc, char** argv) {
     std::string file_name;
 
+    // THUNDER_TRACE=parser,sema switches tracing on -- the trace is printed on exit
+    if (!trace_enable(getenv("THUNDER_TRACE")))
+        return 1;
+
     if (argc < 2) {
-        std::string input = read_file((char*)"tests/test0.tb");
-        Compiler *compiler = new Compiler(input);
+        SourceBuffer *source = read_file((char*)"tests/test0.tb");
+        if (source == nullptr)
+            return 1;
+        Compiler *compiler = new Compiler(source);
 
+        // THUNDER_AST_CACHE=file keeps the AST in the file, so the next run does not parse an unchanged source
+        compiler->ast_cache = getenv("THUNDER_AST_CACHE");
         compiler->test_parser();
 
         delete compiler;
+    } else if (strcmp(argv[1], "--test") == 0) {
+        // Run the self checks of the front end
+        bool passed = test_lexer();
+        passed = test_parallel_lexer() && passed;
+        passed = test_parser_recovery() && passed;
+        printf("%s\n", passed ? "all tests passed" : "TESTS FAILED");
+        return passed ? 0 : 1;
+    } else if (strcmp(argv[1], "-E") == 0 && argc >= 3) {
+        // Print the source the way the lexer sees it -- without comments and directives
+        SourceBuffer *source = read_file(argv[2]);
+        if (source == nullptr)
+            return 1;
+        Preprocessor *preprocessor = new Preprocessor(source);
+        std::string_view output = preprocessor->process();
+        fwrite(output.data(), 1, output.length(), stdout);
+
+        delete preprocessor;
+        delete source;
     } else {
         // Read the file specified through the command line argument
         // ignore all other args for now
         file_name = argv[1];
         printf("fdn: %s\n", file_name.c_str());
-        std::string input = read_file(argv[1]);
-        std::cout << input << std::endl;
+        SourceBuffer *source = read_file(argv[1]);
+        if (source == nullptr)
+            return 1;
+        std::cout << source->text() << std::endl;
 
-        Lexer *lex = new Lexer(input);
-        for (token_t tok; tok.type != TOK_EOF && tok.type != TOK_ILLEGAL; tok = lex->next_token()) 
+        ErrorHandler *error_handler = new ErrorHandler(source->text());
+        Lexer *lex = new Lexer(source->text());
+        lex->error_handler = error_handler;
+        for (token_t tok = lex->next_token(); tok.type != TOK_EOF && tok.type != TOK_ILLEGAL; tok = lex->next_token()) 
             std::cout << tok.literal << std::endl;
+
+        delete lex;
+        delete error_handler;
+        delete source;
     }
 
     return 0;
 }
 
 // read input from file
-std::string
+// the file is memory mapped when possible, so this does not copy the source
+SourceBuffer*
 read_file(char *file_name) {
-    std::ifstream fin(file_name);
-
-    std::stringstream buf;
-    buf << fin.rdbuf();
-    std::string rv = buf.str();
-
-    return rv;
-//    std::string rv;
-//    FILE* fp;
-//    char *file_content;
-//    size_t file_size;
-//    struct stat st;
-//
-//    if (access(file_name, F_OK) != 0) {
-//        perror("read_file (access)");
-//        return "";
-//    }
-//
-//    fp = fopen(file_name, "r");
-//    if (fp == NULL) {
-//        fclose(fp);
-//        perror("read_file (fopen)");
-//        return "";
-//    }
-//
-//    // Get size of the file and read it all in
-//    stat(file_name, &st);
-//    file_size = st.st_size;
-//
-//    file_content = (char*)calloc(file_size, sizeof(char));
-//    if (fread(file_content, file_size, 1, fp) != 1) {
-//        fclose(fp);
-//        perror("read_file (fread)");
-//        free(file_content);
-//        return "";
-//    }
-//
-//    // file read successfully
-//    fclose(fp);
-//    rv = file_content;
-//    free(file_content);
-//    return rv;
+    SourceBuffer *source = new SourceBuffer();
+    if (source->load_file(file_name) == false) {
+        delete source;
+        return nullptr;
+    }
+
+    return source;
 }
 
 bool
@@ -165,7 +173,7 @@ test_lexer() {
         "else {\n"
         "    return false;\n"
         "}\n"
-        "!-/*5;\n"
+        "!-/ *5; // '/*' would start a comment\n"
         "";
 
     std::vector<TokenType> expected4 = {
@@ -201,12 +209,173 @@ test_lexer() {
         token_t tok = lex->next_token();
 
         if (tok.type == expected[i] && tok.literal == expectedlits[i]) {
-            printf("matched %s = %s\n", tok.literal.c_str(), expectedlits[i].c_str());
+            printf("matched " SV_FMT " = %s\n", SV_ARG(tok.literal), expectedlits[i].c_str());
         } else {
-            printf("unexpected token |%s|. expected |%s|\n", tok.literal.c_str(), expectedlits[i].c_str());
+            printf("unexpected token |" SV_FMT "|. expected |%s|\n", SV_ARG(tok.literal), expectedlits[i].c_str());
             return false;
         }
     }
 
     return true;
 }
+
+// Check that lexing on a thread pool gives exactly the tokens and errors of the sequential lexer
+// The chunks are kept tiny so that every line of the input can end up on a chunk boundary
+bool
+test_parallel_lexer() {
+    std::string input;
+    for (int i = 0; i < 2000; i++) {
+        input +=
+            "define int f" + std::to_string(i) + "(int x, float y) {\n"
+            "    let int a = x * " + std::to_string(i) + " + 99999999999999999999;\n"
+            "\n\n    let float b = y / 2.5 # 1.0.0; // a comment with /* in it\n"
+            "    /* a comment\n     over // a few\n     lines */ b /= 2.0;\n"
+            "    while (a >= 3) { a -= 1; }\n"
+            "    return a != b;\n"
+            "}\n";
+    }
+    input += "  @ let end = 1";
+
+    ThreadPool pool(4);
+    for (size_t min_chunk : {(size_t)1, (size_t)17, (size_t)4096, (size_t)LEXER_MIN_CHUNK}) {
+        ErrorHandler sequential_errors;
+        Lexer sequential(input);
+        sequential.error_handler = &sequential_errors;
+        sequential.tokenize_input();
+
+        ErrorHandler parallel_errors;
+        Lexer parallel(input);
+        parallel.error_handler = &parallel_errors;
+        parallel.tokenize_input_parallel(pool, min_chunk);
+
+        const TokenBuffer &a = sequential.tokens;
+        const TokenBuffer &b = parallel.tokens;
+        if (a.size() != b.size()) {
+            printf("parallel lexer: %zu tokens, expected %zu (chunk %zu)\n", b.size(), a.size(), min_chunk);
+            return false;
+        }
+
+        for (size_t i = 0; i < a.size(); i++) {
+            token_t x = a.get(i);
+            token_t y = b.get(i);
+            if (x.type != y.type || x.literal.data() != y.literal.data() || x.literal != y.literal
+                || x.offset != y.offset || memcmp(&x.value, &y.value, sizeof(x.value)) != 0) {
+                printf("parallel lexer: token %zu is |" SV_FMT "| at %u, expected |" SV_FMT "| at %u (chunk %zu)\n",
+                    i, SV_ARG(y.literal), y.offset, SV_ARG(x.literal), x.offset, min_chunk);
+                return false;
+            }
+        }
+
+        if (sequential_errors.error_log.size() != parallel_errors.error_log.size()) {
+            printf("parallel lexer: %zu errors, expected %zu (chunk %zu)\n",
+                parallel_errors.error_log.size(), sequential_errors.error_log.size(), min_chunk);
+            return false;
+        }
+        for (size_t i = 0; i < sequential_errors.error_log.size(); i++) {
+            const ErrorLogEntry &x = sequential_errors.error_log[i];
+            const ErrorLogEntry &y = parallel_errors.error_log[i];
+            if (x.offset != y.offset || x.message != y.message) {
+                printf("parallel lexer: error %zu is at %u '%s', expected at %u '%s' (chunk %zu)\n",
+                    i, y.offset, y.message.c_str(), x.offset, x.message.c_str(), min_chunk);
+                return false;
+            }
+        }
+
+        if (sequential.position != parallel.position) {
+            printf("parallel lexer: lexer did not end where the sequential one did (chunk %zu)\n", min_chunk);
+            return false;
+        }
+    }
+
+    printf("parallel lexer matches the sequential lexer\n");
+    return true;
+}
+
+// Seconds a parse of the garbage in test_parser_recovery may take
+#define RECOVERY_TIME_LIMIT 5
+
+static void
+parser_hung(int) {
+    const char message[] = "parser recovery: parse did not finish in time\n";
+    write(STDOUT_FILENO, message, sizeof(message) - 1);
+    _exit(1);
+}
+
+// Parse garbage and check that the parser gets through it
+// Returns the seconds the parse took, or -1 if the parser ate more tokens than there are
+static double
+parse_garbage(const std::string &input, bool buffered) {
+    auto start = std::chrono::steady_clock::now();
+    Arena arena;
+    SymbolTable symbol_table(&arena);
+    ErrorHandler errors(input);
+    Lexer lexer(input);
+    lexer.error_handler = &errors;
+
+    Parser *parser;
+    if (buffered) {
+        lexer.tokenize_input();
+        parser = new Parser(lexer.tokens);
+    } else {
+        parser = new Parser(&lexer);
+    }
+    parser->error_handler = &errors;
+    parser->symbol_table = &symbol_table;
+    parser->arena = &arena;
+    parser->_create_ast();
+
+    // the lexer made every token, at most one TOK_EOF was eaten at the end
+    size_t eaten = parser->tokens_eaten;
+    delete parser;
+    if (buffered && eaten > lexer.tokens.size())
+        return -1;
+
+    return std::chrono::duration <double> (std::chrono::steady_clock::now() - start).count();
+}
+
+// Check that parsing garbage always ends, and in time linear in its length
+// Random runs of tokens -- bits of statements mixed with junk -- are parsed from the lexer
+// and from a token buffer, then a long run of them and a run of '(' deep enough to blow
+// the stack if nesting were not limited. A parse that spins trips the alarm, which fails
+// the run instead of hanging it. 'entry' is left out of the runs because a second entry
+// point is reported while the parse assigns parents.
+bool
+test_parser_recovery() {
+    static const char *words[] = {
+        "let", "int", "float", "bool", "x", "f", "=", "==", "+", "*", "!", "@", ";", ",",
+        "(", ")", "{", "}", "define", "return", "if", "else", "while", "for", "1", "2.5", "true",
+    };
+    std::mt19937 generator(24);
+    auto garbage = [&](size_t length) {
+        std::string input;
+        for (size_t i = 0; i < length; i++) {
+            input += words[generator() % (sizeof(words) / sizeof(words[0]))];
+            input += ' ';
+        }
+        return input;
+    };
+
+    signal(SIGALRM, parser_hung);
+    std::vector <std::string> inputs;
+    for (int i = 0; i < 2000; i++)
+        inputs.push_back(garbage(generator() % 64));
+    inputs.push_back(garbage(200000));
+    inputs.push_back("define int f() { let int a = " + std::string(100000, '('));
+
+    for (const std::string &input : inputs) {
+        for (bool buffered : {false, true}) {
+            alarm(RECOVERY_TIME_LIMIT + 1);
+            double seconds = parse_garbage(input, buffered);
+            alarm(0);
+
+            if (seconds < 0 || seconds > RECOVERY_TIME_LIMIT) {
+                printf("parser recovery: %s on %zu bytes of garbage: %.20s...\n",
+                    seconds < 0 ? "ate more tokens than there are" : "too slow", input.length(), input.c_str());
+                return false;
+            }
+        }
+    }
+
+    printf("parser recovers from garbage in time\n");
+    return true;
+}